@@ -1,6 +1,16 @@
 // C++ program to implement the Hospital 
 // Management System 
 #include <bits/stdc++.h> 
+#ifdef _WIN32
+#define NOMINMAX
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 using namespace std; 
 
 // Store the data of Hospital 
@@ -13,240 +23,3571 @@ public:
 	string contact; 
 	string doctor_name; 
 	int price; 
+
+	// Position in degrees, NAN when unknown 
+	float latitude = NAN; 
+	float longitude = NAN; 
 }; 
 
-// Stores the data of Patient 
-class Patient : public Hospital { 
-public: 
-	string P_name; 
-	int P_id; 
+// Interns repeated strings so every distinct value is
+// stored once and columns only hold small integer ids.
+// The characters live in large arena blocks and the ids
+// in an open addressing table, so interning a new value
+// costs no allocation of its own and a lookup is one
+// probe sequence over a flat array.
+class StringPool {
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	uint32_t Intern(string_view value)
+	{
+		if ((views.size() + 1) * 2 > slots.size())
+			Rehash(max<size_t>(16, slots.size() * 2));
+
+		uint32_t hash = Hash(value);
+		size_t mask = slots.size() - 1;
+		for (size_t i = hash & mask;; i = (i + 1) & mask) {
+			if (slots[i].id == npos) {
+				slots[i] = { hash, (uint32_t)views.size() };
+				views.push_back(Store(value));
+				return views.size() - 1;
+			}
+			if (slots[i].hash == hash && views[slots[i].id] == value)
+				return slots[i].id;
+		}
+	}
+
+	// Id of an already interned value, or npos.
+	// Never adds to the pool.
+	uint32_t Find(string_view value) const
+	{
+		if (slots.empty())
+			return npos;
+		uint32_t hash = Hash(value);
+		size_t mask = slots.size() - 1;
+		for (size_t i = hash & mask;; i = (i + 1) & mask) {
+			if (slots[i].id == npos)
+				return npos;
+			if (slots[i].hash == hash && views[slots[i].id] == value)
+				return slots[i].id;
+		}
+	}
+
+	// Stays valid for the life of the pool
+	string_view Get(uint32_t id) const
+	{
+		return views[id];
+	}
+
+	size_t Size() const
+	{
+		return views.size();
+	}
+
+	void Reserve(size_t count)
+	{
+		views.reserve(count);
+		size_t wanted = 16;
+		while (wanted < count * 2)
+			wanted *= 2;
+		if (wanted > slots.size())
+			Rehash(wanted);
+	}
+
+private:
+	struct Slot {
+		uint32_t hash;
+		uint32_t id;
+	};
+
+	static const size_t BLOCK_SIZE = 1 << 16;
+
+	vector<string_view> views;
+	vector<Slot> slots;
+	vector<unique_ptr<char[]>> blocks;
+	size_t block_used = BLOCK_SIZE;
+
+	static uint32_t Hash(string_view value)
+	{
+		return std::hash<string_view>()(value);
+	}
+
+	// Copies value into the arena. Blocks are never
+	// moved or freed, so the views stay valid.
+	string_view Store(string_view value)
+	{
+		if (value.size() > BLOCK_SIZE / 4) {
+			blocks.emplace_back(new char[value.size()]);
+			memcpy(blocks.back().get(), value.data(), value.size());
+			string_view stored(blocks.back().get(), value.size());
+			// Keep filling the block that was current
+			if (blocks.size() > 1)
+				swap(blocks[blocks.size() - 1], blocks[blocks.size() - 2]);
+			return stored;
+		}
+		if (blocks.empty() || block_used + value.size() > BLOCK_SIZE) {
+			blocks.emplace_back(new char[BLOCK_SIZE]);
+			block_used = 0;
+		}
+		char* at = blocks.back().get() + block_used;
+		memcpy(at, value.data(), value.size());
+		block_used += value.size();
+		return string_view(at, value.size());
+	}
+
+	void Rehash(size_t size)
+	{
+		vector<Slot> old = move(slots);
+		slots.assign(size, Slot{ 0, npos });
+		size_t mask = size - 1;
+		for (const Slot& slot : old) {
+			if (slot.id == npos)
+				continue;
+			size_t i = slot.hash & mask;
+			while (slots[i].id != npos)
+				i = (i + 1) & mask;
+			slots[i] = slot;
+		}
+	}
+};
+
+// Strings that are mostly distinct, like patient names
+// and phone numbers, packed back to back. Nothing is
+// deduplicated, so a value costs its bytes plus one
+// 8-byte end offset.
+class StringColumn {
+public:
+	void Append(string_view value)
+	{
+		bytes.append(value.data(), value.size());
+		ends.push_back(bytes.size());
+	}
+
+	string_view Get(size_t row) const
+	{
+		size_t begin = row == 0 ? 0 : ends[row - 1];
+		return string_view(bytes.data() + begin, ends[row] - begin);
+	}
+
+	size_t Size() const
+	{
+		return ends.size();
+	}
+
+	void Reserve(size_t rows, size_t average_length)
+	{
+		ends.reserve(rows);
+		bytes.reserve(rows * average_length);
+	}
+
+private:
+	string bytes;
+	vector<uint64_t> ends;
+};
+
+// Canonical form of a city name: surrounding whitespace
+// dropped and inner runs of whitespace folded to one
+// space, so "Mumbai " and "Mumbai" are the same city
+string NormalizeCity(string_view city)
+{
+	string normalized;
+	normalized.reserve(city.size());
+	bool pending_space = false;
+	for (char c : city) {
+		if (isspace((unsigned char)c)) {
+			pending_space = !normalized.empty();
+			continue;
+		}
+		if (pending_space)
+			normalized += ' ';
+		pending_space = false;
+		normalized += c;
+	}
+	return normalized;
+}
+
+// Orders a hospital listing can be ranked by
+enum SortKey {
+	BY_NAME, // name, descending
+	BY_RATING, // rating, best first
+	BY_BEDS, // available beds, most first
+	BY_PRICE, // price per bed, cheapest first
+	SORT_KEY_COUNT
+};
+
+// Stores the hospitals column by column (structure of
+// arrays). The numeric columns are contiguous, so scans
+// and filters on beds, rating or price only touch the
+// bytes they need and compile to tight vector loops.
+// Row i of every column belongs to the same hospital.
+class HospitalTable {
+public:
+	// Told about every change to the table once it is
+	// made, on the thread that made it, e.g. to keep
+	// running totals in step with the table
+	class Observer {
+	public:
+		virtual ~Observer() = default;
+		virtual void HospitalAdded(const HospitalTable& table,
+			uint32_t row) = 0;
+		virtual void BedsSet(uint32_t row, int beds) = 0;
+		virtual void RatingSet(uint32_t row, float value) = 0;
+		virtual void PriceSet(uint32_t row, int value) = 0;
+	};
+
+	// The table keeps the pointer, so it must not be
+	// moved while an observer is registered
+	void AddObserver(Observer* observer)
+	{
+		observers.push_back(observer);
+	}
+
+	void RemoveObserver(Observer* observer)
+	{
+		observers.erase(remove(observers.begin(), observers.end(), observer),
+			observers.end());
+	}
+
+	uint32_t AddHospital(const Hospital& h)
+	{
+		return AddInterned(InternName(h.H_name), InternCity(h.location),
+			InternDoctor(h.doctor_name), h.contact, h.available_beds,
+			h.rating, h.price, h.latitude, h.longitude);
+	}
+
+	// Makes room for rows more hospitals, so a bulk load
+	// does not regrow columns or rehash the name pool
+	void Reserve(size_t rows)
+	{
+		size_t total = Size() + rows;
+		H_name.reserve(total);
+		location.reserve(total);
+		doctor_name.reserve(total);
+		contact.reserve(total);
+		available_beds.reserve(total);
+		rating.reserve(total);
+		price.reserve(total);
+		latitude.reserve(total);
+		longitude.reserve(total);
+		names.Reserve(total);
+	}
+
+	// Bulk loaders intern each distinct value once through
+	// these and then add rows by id
+	uint32_t InternName(string_view value)
+	{
+		return names.Intern(value);
+	}
+
+	uint32_t InternCity(string_view value)
+	{
+		return locations.Intern(NormalizeCity(value));
+	}
+
+	uint32_t InternDoctor(string_view value)
+	{
+		return doctors.Intern(value);
+	}
+
+	uint32_t AddInterned(uint32_t name, uint32_t city, uint32_t doctor,
+		string_view phone, int beds, float stars, int cost,
+		float lat = NAN, float lon = NAN)
+	{
+		if (city >= city_rows.size())
+			city_rows.resize(city + 1);
+		city_rows[city].push_back(H_name.size());
+
+		H_name.push_back(name);
+		location.push_back(city);
+		doctor_name.push_back(doctor);
+		contact.emplace_back(phone);
+		available_beds.push_back(beds);
+		rating.push_back(stars);
+		price.push_back(cost);
+		latitude.push_back(lat);
+		longitude.push_back(lon);
+
+		// Inserting into each view would be O(n) per row and
+		// make bulk loads quadratic; they are rebuilt on use
+		for (int key = 0; key < SORT_KEY_COUNT; key++)
+			views[key].valid.store(false, memory_order_relaxed);
+		uint32_t row = H_name.size() - 1;
+		for (Observer* observer : observers)
+			observer->HospitalAdded(*this, row);
+		return row;
+	}
+
+	// Setters keep every cached sorted view in order
+	// by moving just the updated row
+	void SetBeds(uint32_t row, int beds)
+	{
+		Update(BY_BEDS, row, [&] { available_beds[row] = beds; });
+		for (Observer* observer : observers)
+			observer->BedsSet(row, beds);
+	}
+
+	void SetRating(uint32_t row, float value)
+	{
+		Update(BY_RATING, row, [&] { rating[row] = value; });
+		for (Observer* observer : observers)
+			observer->RatingSet(row, value);
+	}
+
+	void SetPrice(uint32_t row, int value)
+	{
+		Update(BY_PRICE, row, [&] { price[row] = value; });
+		for (Observer* observer : observers)
+			observer->PriceSet(row, value);
+	}
+
+	// Row ids ordered by key. This is a view over the
+	// table, no hospital is copied. It is sorted on first
+	// use, kept in order by the setters and rebuilt after
+	// hospitals are added, so repeated listings cost
+	// nothing. Any number of threads may read the table at
+	// once, and the first build is done by one of them
+	// under the view's lock; changes still need the table
+	// to themselves.
+	const vector<uint32_t>& SortedBy(SortKey key) const
+	{
+		SortedView& view = views[key];
+		if (!view.valid.load(memory_order_acquire)) {
+			lock_guard<mutex> lock(view.build);
+			if (!view.valid.load(memory_order_relaxed)) {
+				view.rows.resize(Size());
+				iota(view.rows.begin(), view.rows.end(), 0);
+				sort(view.rows.begin(), view.rows.end(), Order(key));
+				view.valid.store(true, memory_order_release);
+			}
+		}
+		return view.rows;
+	}
+
+	// The first k rows by key. Reads the prefix of the
+	// sorted view when it is already built, otherwise a
+	// partial_sort in O(n log k) without building it.
+	vector<uint32_t> TopK(SortKey key, size_t k) const
+	{
+		k = min(k, Size());
+		if (HasSortedView(key))
+			return vector<uint32_t>(views[key].rows.begin(),
+				views[key].rows.begin() + k);
+
+		vector<uint32_t> rows(Size());
+		iota(rows.begin(), rows.end(), 0);
+		partial_sort(rows.begin(), rows.begin() + k, rows.end(),
+			Order(key));
+		rows.resize(k);
+		return rows;
+	}
+
+	// The k cheapest hospitals with at least min_beds
+	// free beds, walking the price view until k are found
+	vector<uint32_t> CheapestWithBeds(size_t k, int min_beds = 1) const
+	{
+		vector<uint32_t> rows;
+		for (uint32_t row : SortedBy(BY_PRICE)) {
+			if (rows.size() == k)
+				break;
+			if (available_beds[row] >= min_beds)
+				rows.push_back(row);
+		}
+		return rows;
+	}
+
+	// Range queries binary search the sorted views, so
+	// they cost O(log n + matches). Bounds are inclusive.
+
+	// Positions [first, last) of SortedBy(key) whose
+	// value lies in [low, high]. Names have no range, so
+	// BY_NAME covers the whole view.
+	pair<size_t, size_t> SortedRange(SortKey key,
+		double low, double high) const
+	{
+		const vector<uint32_t>& order = SortedBy(key);
+		auto first = order.begin(), last = order.end();
+		switch (key) {
+		case BY_RATING:
+			first = partition_point(first, last,
+				[&](uint32_t r) { return rating[r] > high; });
+			last = partition_point(first, last,
+				[&](uint32_t r) { return rating[r] >= low; });
+			break;
+		case BY_BEDS:
+			first = partition_point(first, last,
+				[&](uint32_t r) { return available_beds[r] > high; });
+			last = partition_point(first, last,
+				[&](uint32_t r) { return available_beds[r] >= low; });
+			break;
+		case BY_PRICE:
+			first = partition_point(first, last,
+				[&](uint32_t r) { return price[r] < low; });
+			last = partition_point(first, last,
+				[&](uint32_t r) { return price[r] <= high; });
+			break;
+		default:
+			break;
+		}
+		return { first - order.begin(), last - order.begin() };
+	}
+
+	// Rows with price in [low, high], cheapest first
+	vector<uint32_t> PriceBetween(int low, int high) const
+	{
+		return Slice(BY_PRICE, SortedRange(BY_PRICE, low, high));
+	}
+
+	// Rows with rating in [low, high], best first
+	vector<uint32_t> RatingBetween(float low, float high) const
+	{
+		return Slice(BY_RATING, SortedRange(BY_RATING, low, high));
+	}
+
+	// Rows with free beds in [low, high], most first
+	vector<uint32_t> BedsBetween(int low, int high) const
+	{
+		return Slice(BY_BEDS, SortedRange(BY_BEDS, low, high));
+	}
+
+	// True once the sorted view of key is built and
+	// being maintained
+	bool HasSortedView(SortKey key) const
+	{
+		return views[key].valid.load(memory_order_acquire);
+	}
+
+	// Puts the first k of rows in key order and drops
+	// the rest, without sorting the tail
+	void SortRows(SortKey key, vector<uint32_t>& rows, size_t k) const
+	{
+		k = min(k, rows.size());
+		partial_sort(rows.begin(), rows.begin() + k, rows.end(),
+			Order(key));
+		rows.resize(k);
+	}
+
+	size_t Size() const
+	{
+		return H_name.size();
+	}
+
+	// Row ids of the hospitals in a city, in insertion
+	// order. One hash lookup on the normalized name, then
+	// the rows come straight from the per-city index.
+	const vector<uint32_t>& RowsInCity(const string& city) const
+	{
+		static const vector<uint32_t> none;
+		uint32_t id = FindCity(city);
+		return id == StringPool::npos ? none : city_rows[id];
+	}
+
+	const vector<uint32_t>& RowsInCity(uint32_t city) const
+	{
+		return city_rows[city];
+	}
+
+	// City id of a name, or StringPool::npos if no
+	// hospital is in that city
+	uint32_t FindCity(string_view city) const
+	{
+		return locations.Find(NormalizeCity(city));
+	}
+
+	uint32_t CityId(uint32_t row) const
+	{
+		return location[row];
+	}
+
+	const vector<uint32_t>& CityIds() const
+	{
+		return location;
+	}
+
+	size_t CityCount() const
+	{
+		return city_rows.size();
+	}
+
+	string_view Name(uint32_t row) const
+	{
+		return names.Get(H_name[row]);
+	}
+
+	string_view Location(uint32_t row) const
+	{
+		return locations.Get(location[row]);
+	}
+
+	string_view Doctor(uint32_t row) const
+	{
+		return doctors.Get(doctor_name[row]);
+	}
+
+	const string& Contact(uint32_t row) const
+	{
+		return contact[row];
+	}
+
+	const vector<int>& Beds() const
+	{
+		return available_beds;
+	}
+
+	const vector<float>& Ratings() const
+	{
+		return rating;
+	}
+
+	const vector<int>& Prices() const
+	{
+		return price;
+	}
+
+	const vector<float>& Latitudes() const
+	{
+		return latitude;
+	}
+
+	const vector<float>& Longitudes() const
+	{
+		return longitude;
+	}
+
+	// Rebuilds a row object, for code that still
+	// works on whole hospitals
+	Hospital Row(uint32_t row) const
+	{
+		Hospital h;
+		h.H_name = Name(row);
+		h.location = Location(row);
+		h.available_beds = available_beds[row];
+		h.rating = rating[row];
+		h.contact = contact[row];
+		h.doctor_name = Doctor(row);
+		h.price = price[row];
+		h.latitude = latitude[row];
+		h.longitude = longitude[row];
+		return h;
+	}
+
+	vector<Hospital> Rows() const
+	{
+		vector<Hospital> rows;
+		rows.reserve(Size());
+		for (uint32_t i = 0; i < Size(); i++)
+			rows.push_back(Row(i));
+		return rows;
+	}
+
+	// Total free beds over all hospitals
+	long long TotalFreeBeds() const
+	{
+		long long total = 0;
+		for (size_t i = 0; i < available_beds.size(); i++)
+			total += available_beds[i];
+		return total;
+	}
+
+	// Row ids of hospitals with at least min_beds free beds
+	vector<uint32_t> FilterByBeds(int min_beds) const
+	{
+		return Select(available_beds,
+			[min_beds](int beds) { return beds >= min_beds; });
+	}
+
+	// Row ids of hospitals rated at least min_rating
+	vector<uint32_t> FilterByRating(float min_rating) const
+	{
+		return Select(rating,
+			[min_rating](float r) { return r >= min_rating; });
+	}
+
+	// Row ids of hospitals charging at most max_price per bed
+	vector<uint32_t> FilterByPrice(int max_price) const
+	{
+		return Select(price,
+			[max_price](int p) { return p <= max_price; });
+	}
+
+private:
+	vector<uint32_t> H_name;
+	vector<uint32_t> location;
+	vector<uint32_t> doctor_name;
+	vector<string> contact;
+	vector<int> available_beds;
+	vector<float> rating;
+	vector<int> price;
+	vector<float> latitude;
+	vector<float> longitude;
+
+	StringPool names;
+	StringPool locations;
+	StringPool doctors;
+
+	// city id -> row ids, the secondary index on location
+	vector<vector<uint32_t>> city_rows;
+
+	// A cached order of the rows. Copying a table copies
+	// the rows and the flag and gives the copy its own lock.
+	struct SortedView {
+		vector<uint32_t> rows;
+		atomic<bool> valid{ false };
+		mutex build;
+
+		SortedView() = default;
+
+		SortedView(const SortedView& other)
+			: rows(other.rows), valid(other.valid.load())
+		{
+		}
+
+		SortedView& operator=(const SortedView& other)
+		{
+			rows = other.rows;
+			valid.store(other.valid.load());
+			return *this;
+		}
+
+		SortedView(SortedView&& other) noexcept
+			: rows(move(other.rows)), valid(other.valid.load())
+		{
+		}
+
+		SortedView& operator=(SortedView&& other) noexcept
+		{
+			rows = move(other.rows);
+			valid.store(other.valid.load());
+			return *this;
+		}
+	};
+
+	mutable SortedView views[SORT_KEY_COUNT];
+
+	vector<Observer*> observers;
+
+	// Comparator on row ids for a sort key. Ties go to the
+	// lower row id, so every row has exactly one position
+	// and can be found again by binary search.
+	struct RowOrder {
+		const HospitalTable* table;
+		SortKey key;
+
+		bool operator()(uint32_t a, uint32_t b) const
+		{
+			const HospitalTable& t = *table;
+			switch (key) {
+			case BY_NAME:
+				if (t.Name(a) != t.Name(b))
+					return t.Name(a) > t.Name(b);
+				break;
+			case BY_RATING:
+				if (t.rating[a] != t.rating[b])
+					return t.rating[a] > t.rating[b];
+				break;
+			case BY_BEDS:
+				if (t.available_beds[a] != t.available_beds[b])
+					return t.available_beds[a] > t.available_beds[b];
+				break;
+			default:
+				if (t.price[a] != t.price[b])
+					return t.price[a] < t.price[b];
+				break;
+			}
+			return a < b;
+		}
+	};
+
+	RowOrder Order(SortKey key) const
+	{
+		return RowOrder{ this, key };
+	}
+
+	vector<uint32_t> Slice(SortKey key, pair<size_t, size_t> range) const
+	{
+		const vector<uint32_t>& order = views[key].rows;
+		return vector<uint32_t>(order.begin() + range.first,
+			order.begin() + range.second);
+	}
+
+	// Applies a change to the column behind key and moves
+	// the row to its new place in that key's sorted view
+	template <typename Change>
+	void Update(SortKey key, uint32_t row, Change change)
+	{
+		if (!HasSortedView(key)) {
+			change();
+			return;
+		}
+
+		vector<uint32_t>& order = views[key].rows;
+		auto less = Order(key);
+		auto old_pos = lower_bound(order.begin(), order.end(), row, less);
+		change();
+
+		if (old_pos != order.begin() && less(row, *(old_pos - 1))) {
+			auto new_pos = upper_bound(order.begin(), old_pos, row, less);
+			rotate(new_pos, old_pos, old_pos + 1);
+		}
+		else if (old_pos + 1 != order.end() && less(*(old_pos + 1), row)) {
+			auto new_pos = lower_bound(old_pos + 1, order.end(), row, less);
+			rotate(old_pos, old_pos + 1, new_pos);
+		}
+	}
+
+	// Branch-free selection: every row id is written and
+	// the cursor only advances when the predicate holds,
+	// so the loop has no data-dependent jumps
+	template <typename T, typename Pred>
+	static vector<uint32_t> Select(const vector<T>& column, Pred pred)
+	{
+		vector<uint32_t> rows(column.size());
+		size_t count = 0;
+		for (size_t i = 0; i < column.size(); i++) {
+			rows[count] = i;
+			count += pred(column[i]);
+		}
+		rows.resize(count);
+		return rows;
+	}
+};
+
+// Columns a query can project
+enum HospitalColumn {
+	COL_NAME,
+	COL_CITY,
+	COL_BEDS,
+	COL_RATING,
+	COL_CONTACT,
+	COL_DOCTOR,
+	COL_PRICE,
+	COL_LATITUDE,
+	COL_LONGITUDE,
+	HOSPITAL_COLUMN_COUNT
+};
+
+// A lazy query over a HospitalTable. The builder calls
+// only record the stages:
+//
+//   HospitalQuery(hospitals).InCity("Bangalore").MinBeds(1)
+//       .OrderBy(BY_PRICE).Limit(10).ForEach(print);
+//
+// and ForEach runs them as one pass. The rows come from
+// the narrowest index that fits: the city index, the
+// sorted view of the requested order (cut down by binary
+// search when the filter is on the same column), or
+// otherwise a built sorted view of a filtered column.
+// Candidates are filtered a block at a time, one column
+// per predicate, and each surviving row goes straight to
+// the callback; walking a sorted view stops as soon as
+// the limit is reached. Only an order the source does
+// not already have (a small city's rows by price)
+// collects the matches, and then only the top limit are
+// sorted; a big city walks the built view of the order
+// instead.
+//
+// The query keeps a reference to the table, which must
+// not change while it runs.
+class HospitalQuery {
+public:
+	explicit HospitalQuery(const HospitalTable& hospitals)
+		: hospitals(hospitals)
+	{
+	}
+
+	HospitalQuery& InCity(string_view name)
+	{
+		city = hospitals.FindCity(name);
+		city_missing = city == StringPool::npos;
+		return *this;
+	}
+
+	HospitalQuery& BedsBetween(int low, int high)
+	{
+		beds = { true, low, high };
+		return *this;
+	}
+
+	HospitalQuery& MinBeds(int low)
+	{
+		return BedsBetween(low, INT_MAX);
+	}
+
+	HospitalQuery& RatingBetween(float low, float high)
+	{
+		rating = { true, low, high };
+		return *this;
+	}
+
+	HospitalQuery& MinRating(float low)
+	{
+		return RatingBetween(low, numeric_limits<float>::infinity());
+	}
+
+	HospitalQuery& PriceBetween(int low, int high)
+	{
+		price = { true, low, high };
+		return *this;
+	}
+
+	HospitalQuery& MaxPrice(int high)
+	{
+		return PriceBetween(INT_MIN, high);
+	}
+
+	HospitalQuery& OrderBy(SortKey key)
+	{
+		order = key;
+		ordered = true;
+		return *this;
+	}
+
+	HospitalQuery& Limit(size_t count)
+	{
+		limit = count;
+		return *this;
+	}
+
+	// Columns for whoever prints the result. All but
+	// the coordinates unless set.
+	HospitalQuery& Project(initializer_list<HospitalColumn> list)
+	{
+		columns.assign(list.begin(), list.end());
+		return *this;
+	}
+
+	const vector<HospitalColumn>& Columns() const
+	{
+		return columns;
+	}
+
+	// Runs the query, calling emit(row) for each result
+	// in order
+	template <typename Emit>
+	void ForEach(Emit emit) const
+	{
+		if (limit == 0 || city_missing)
+			return;
+		size_t emitted = 0;
+		auto take = [&](uint32_t row) {
+			emit(row);
+			return ++emitted < limit;
+		};
+
+		if (city != StringPool::npos) {
+			const vector<uint32_t>& rows = hospitals.RowsInCity(city);
+			// Walking a built view of the order finds limit
+			// matches after about limit * n / rows rows, which
+			// beats gathering a big city's rows to sort them
+			if (ordered && hospitals.HasSortedView(order)
+				&& double(limit) * hospitals.Size()
+					< double(rows.size()) * rows.size()) {
+				pair<size_t, size_t> range = RangeIn(order);
+				Scan(hospitals.SortedBy(order).data() + range.first,
+					range.second - range.first, take, { true, city, city });
+			}
+			else if (ordered)
+				SortedScan(rows.data(), rows.size(), take);
+			else
+				Scan(rows.data(), rows.size(), take);
+			return;
+		}
+
+		if (ordered) {
+			pair<size_t, size_t> range = RangeIn(order);
+			Scan(hospitals.SortedBy(order).data() + range.first,
+				range.second - range.first, take);
+			return;
+		}
+
+		// Unordered: the smallest range of a view that
+		// is already built, else every row
+		const uint32_t* rows = nullptr;
+		size_t count = hospitals.Size();
+		for (int key = BY_RATING; key < SORT_KEY_COUNT; key++) {
+			if (!Filters(SortKey(key)) || !hospitals.HasSortedView(SortKey(key)))
+				continue;
+			pair<size_t, size_t> range = RangeIn(SortKey(key));
+			if (range.second - range.first < count) {
+				rows = hospitals.SortedBy(SortKey(key)).data() + range.first;
+				count = range.second - range.first;
+			}
+		}
+		Scan(rows, count, take);
+	}
+
+	// Runs the query into a vector of row ids
+	vector<uint32_t> Rows() const
+	{
+		vector<uint32_t> rows;
+		ForEach([&](uint32_t row) { rows.push_back(row); });
+		return rows;
+	}
+
+private:
+	template <typename T>
+	struct Range {
+		bool active;
+		T low;
+		T high;
+	};
+
+	static constexpr size_t BLOCK = 256;
+
+	const HospitalTable& hospitals;
+	uint32_t city = StringPool::npos;
+	bool city_missing = false;
+	Range<int> beds = { false, 0, 0 };
+	Range<float> rating = { false, 0, 0 };
+	Range<int> price = { false, 0, 0 };
+	SortKey order = BY_NAME;
+	bool ordered = false;
+	size_t limit = SIZE_MAX;
+	vector<HospitalColumn> columns = { COL_NAME, COL_CITY, COL_BEDS,
+		COL_RATING, COL_CONTACT, COL_DOCTOR, COL_PRICE };
+
+	bool Filters(SortKey key) const
+	{
+		return key == BY_RATING ? rating.active
+			: key == BY_BEDS ? beds.active
+			: key == BY_PRICE ? price.active
+			: false;
+	}
+
+	pair<size_t, size_t> RangeIn(SortKey key) const
+	{
+		switch (key) {
+		case BY_RATING:
+			if (rating.active)
+				return hospitals.SortedRange(key, rating.low, rating.high);
+			break;
+		case BY_BEDS:
+			if (beds.active)
+				return hospitals.SortedRange(key, beds.low, beds.high);
+			break;
+		case BY_PRICE:
+			if (price.active)
+				return hospitals.SortedRange(key, price.low, price.high);
+			break;
+		default:
+			break;
+		}
+		return { 0, hospitals.SortedBy(key).size() };
+	}
+
+	// Keeps the rows of block whose value in column is
+	// in range, compacting them to the front without a
+	// data-dependent branch. Returns how many are left.
+	template <typename T>
+	static size_t Keep(uint32_t* block, size_t count,
+		const vector<T>& column, const Range<T>& range)
+	{
+		if (!range.active)
+			return count;
+		size_t kept = 0;
+		for (size_t i = 0; i < count; i++) {
+			uint32_t row = block[i];
+			block[kept] = row;
+			kept += (column[row] >= range.low) & (column[row] <= range.high);
+		}
+		return kept;
+	}
+
+	// Filters rows (every row when null) and passes the
+	// matches to take until it returns false
+	template <typename Take>
+	void Scan(const uint32_t* rows, size_t count, Take take,
+		Range<uint32_t> in_city = { false, 0, 0 }) const
+	{
+		uint32_t block[BLOCK];
+		for (size_t start = 0; start < count; start += BLOCK) {
+			size_t n = min(BLOCK, count - start);
+			for (size_t i = 0; i < n; i++)
+				block[i] = rows ? rows[start + i] : uint32_t(start + i);
+			n = Keep(block, n, hospitals.CityIds(), in_city);
+			n = Keep(block, n, hospitals.Beds(), beds);
+			n = Keep(block, n, hospitals.Ratings(), rating);
+			n = Keep(block, n, hospitals.Prices(), price);
+			for (size_t i = 0; i < n; i++)
+				if (!take(block[i]))
+					return;
+		}
+	}
+
+	// Scan for a source not in the requested order:
+	// gathers the matches, then orders only the first
+	// limit of them
+	template <typename Take>
+	void SortedScan(const uint32_t* rows, size_t count, Take take) const
+	{
+		vector<uint32_t> matches;
+		Scan(rows, count, [&](uint32_t row) {
+			matches.push_back(row);
+			return true;
+		});
+		hospitals.SortRows(order, matches, limit);
+		for (uint32_t row : matches)
+			if (!take(row))
+				return;
+	}
+};
+
+// Stores the patients column by column. A patient's
+// row is its stable id, and the allotted hospital is a
+// HospitalTable row, so finding a patient's hospital is
+// a single array read. A patient costs four 4-byte
+// fields, two 8-byte string offsets and the bytes of its
+// name and contact; cities are interned.
+class PatientTable {
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	uint32_t AddPatient(string_view name, int id, string_view phone,
+		string_view city, int cost, uint32_t hospital = npos)
+	{
+		P_name.Append(name);
+		P_id.push_back(id);
+		contact.Append(phone);
+		location.push_back(cities.Intern(NormalizeCity(city)));
+		expenditure.push_back(cost);
+		allotted.push_back(hospital);
+		return P_id.size() - 1;
+	}
+
+	void Reserve(size_t rows)
+	{
+		size_t total = Size() + rows;
+		P_name.Reserve(total, 16);
+		P_id.reserve(total);
+		contact.Reserve(total, 12);
+		location.reserve(total);
+		expenditure.reserve(total);
+		allotted.reserve(total);
+	}
+
+	size_t Size() const
+	{
+		return P_id.size();
+	}
+
+	string_view Name(uint32_t row) const
+	{
+		return P_name.Get(row);
+	}
+
+	int Id(uint32_t row) const
+	{
+		return P_id[row];
+	}
+
+	string_view Contact(uint32_t row) const
+	{
+		return contact.Get(row);
+	}
+
+	string_view City(uint32_t row) const
+	{
+		return cities.Get(location[row]);
+	}
+
+	int Expenditure(uint32_t row) const
+	{
+		return expenditure[row];
+	}
+
+	// Allotted hospital row, or npos while waiting
+	uint32_t HospitalOf(uint32_t row) const
+	{
+		return allotted[row];
+	}
+
+	void SetHospital(uint32_t row, uint32_t hospital)
+	{
+		allotted[row] = hospital;
+	}
+
+	void SetCity(uint32_t row, string_view city)
+	{
+		location[row] = cities.Intern(NormalizeCity(city));
+	}
+
+	// Drops every allotment, e.g. after the hospital
+	// rows they pointed at were replaced
+	void ClearHospitals()
+	{
+		fill(allotted.begin(), allotted.end(), npos);
+	}
+
+private:
+	StringColumn P_name;
+	vector<int> P_id;
+	StringColumn contact;
+	vector<uint32_t> location;
+	vector<int> expenditure;
+	vector<uint32_t> allotted;
+
+	StringPool cities;
+};
+
+// Nearest hospital search over the table's coordinates.
+// Positions are turned into points on the unit sphere
+// and kept in a k-d tree. Straight-line (chord) distance
+// between those points grows with great circle distance,
+// so ordinary Euclidean pruning is exact, with no special
+// cases at the poles or across the 180th meridian.
+// Free beds are read live from the table at query time.
+// Rebuild the locator after adding hospitals.
+class HospitalLocator {
+public:
+	static constexpr double EARTH_RADIUS_KM = 6371.0;
+
+	explicit HospitalLocator(const HospitalTable& hospitals)
+		: hospitals(hospitals)
+	{
+		for (uint32_t row = 0; row < hospitals.Size(); row++) {
+			float lat = hospitals.Latitudes()[row];
+			float lon = hospitals.Longitudes()[row];
+			if (isnan(lat) || isnan(lon))
+				continue;
+			Point p;
+			ToUnit(lat, lon, p.xyz);
+			p.row = row;
+			points.push_back(p);
+		}
+		axes.resize(points.size());
+		Build(0, points.size());
+	}
+
+	// (row, km) of the k nearest hospitals with at least
+	// min_beds free beds, nearest first. Empty for a NaN or
+	// infinite position, which is near nothing.
+	vector<pair<uint32_t, double>> Nearest(float lat, float lon,
+		size_t k, int min_beds = 1) const
+	{
+		float q[3];
+		ToUnit(lat, lon, q);
+		vector<pair<float, uint32_t>> best; // max-heap on chord^2
+		if (k > 0 && isfinite(lat) && isfinite(lon))
+			SearchNearest(0, points.size(), q, k, min_beds, best);
+		sort_heap(best.begin(), best.end());
+		return ToKm(best);
+	}
+
+	// (row, km) of hospitals within km with at least
+	// min_beds free beds, nearest first. Empty for a NaN or
+	// infinite position, as for Nearest.
+	vector<pair<uint32_t, double>> Within(float lat, float lon,
+		double km, int min_beds = 1) const
+	{
+		float q[3];
+		ToUnit(lat, lon, q);
+		double chord = 2 * sin(min(km / EARTH_RADIUS_KM, M_PI) / 2);
+		vector<pair<float, uint32_t>> found;
+		if (isfinite(lat) && isfinite(lon))
+			SearchWithin(0, points.size(), q, chord * chord, min_beds, found);
+		sort(found.begin(), found.end());
+		return ToKm(found);
+	}
+
+	// Great circle distance in km
+	static double DistanceKm(float lat1, float lon1, float lat2, float lon2)
+	{
+		float a[3], b[3];
+		ToUnit(lat1, lon1, a);
+		ToUnit(lat2, lon2, b);
+		return ChordToKm(Distance2(a, b));
+	}
+
+private:
+	struct Point {
+		float xyz[3];
+		uint32_t row;
+	};
+
+	const HospitalTable& hospitals;
+	vector<Point> points; // implicit tree, node at the middle
+	vector<uint8_t> axes; // split axis of the node at each index
+
+	static void ToUnit(float lat, float lon, float* out)
+	{
+		double phi = lat * M_PI / 180, lambda = lon * M_PI / 180;
+		out[0] = cos(phi) * cos(lambda);
+		out[1] = cos(phi) * sin(lambda);
+		out[2] = sin(phi);
+	}
+
+	static const float* Coords(const Point& p)
+	{
+		return p.xyz;
+	}
+
+	static float Distance2(const float* a, const float* b)
+	{
+		float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	static double ChordToKm(float chord2)
+	{
+		return 2 * EARTH_RADIUS_KM * asin(min(1.0, sqrt((double)chord2) / 2));
+	}
+
+	static vector<pair<uint32_t, double>> ToKm(
+		const vector<pair<float, uint32_t>>& hits)
+	{
+		vector<pair<uint32_t, double>> result;
+		result.reserve(hits.size());
+		for (const pair<float, uint32_t>& hit : hits)
+			result.emplace_back(hit.second, ChordToKm(hit.first));
+		return result;
+	}
+
+	// Splits on the axis with the widest spread, which
+	// matters because a country's hospitals sit on a
+	// nearly flat patch of the sphere
+	void Build(size_t lo, size_t hi)
+	{
+		if (hi - lo <= 1)
+			return;
+		float low[3] = { 2, 2, 2 }, high[3] = { -2, -2, -2 };
+		for (size_t i = lo; i < hi; i++)
+			for (int a = 0; a < 3; a++) {
+				low[a] = min(low[a], Coords(points[i])[a]);
+				high[a] = max(high[a], Coords(points[i])[a]);
+			}
+		int axis = 0;
+		for (int a = 1; a < 3; a++)
+			if (high[a] - low[a] > high[axis] - low[axis])
+				axis = a;
+
+		size_t mid = lo + (hi - lo) / 2;
+		nth_element(points.begin() + lo, points.begin() + mid,
+			points.begin() + hi, [axis](const Point& a, const Point& b) {
+				return Coords(a)[axis] < Coords(b)[axis];
+			});
+		axes[mid] = axis;
+		Build(lo, mid);
+		Build(mid + 1, hi);
+	}
+
+	void SearchNearest(size_t lo, size_t hi, const float* q, size_t k,
+		int min_beds, vector<pair<float, uint32_t>>& best) const
+	{
+		if (lo >= hi)
+			return;
+		size_t mid = lo + (hi - lo) / 2;
+		const Point& p = points[mid];
+
+		if (hospitals.Beds()[p.row] >= min_beds) {
+			float d2 = Distance2(q, Coords(p));
+			if (best.size() < k) {
+				best.emplace_back(d2, p.row);
+				push_heap(best.begin(), best.end());
+			}
+			else if (d2 < best.front().first) {
+				pop_heap(best.begin(), best.end());
+				best.back() = { d2, p.row };
+				push_heap(best.begin(), best.end());
+			}
+		}
+		if (hi - lo == 1)
+			return;
+
+		float diff = q[axes[mid]] - Coords(p)[axes[mid]];
+		if (diff < 0) {
+			SearchNearest(lo, mid, q, k, min_beds, best);
+			if (best.size() < k || diff * diff < best.front().first)
+				SearchNearest(mid + 1, hi, q, k, min_beds, best);
+		}
+		else {
+			SearchNearest(mid + 1, hi, q, k, min_beds, best);
+			if (best.size() < k || diff * diff < best.front().first)
+				SearchNearest(lo, mid, q, k, min_beds, best);
+		}
+	}
+
+	void SearchWithin(size_t lo, size_t hi, const float* q, float radius2,
+		int min_beds, vector<pair<float, uint32_t>>& found) const
+	{
+		if (lo >= hi)
+			return;
+		size_t mid = lo + (hi - lo) / 2;
+		const Point& p = points[mid];
+
+		float d2 = Distance2(q, Coords(p));
+		if (d2 <= radius2 && hospitals.Beds()[p.row] >= min_beds)
+			found.emplace_back(d2, p.row);
+		if (hi - lo == 1)
+			return;
+
+		float diff = q[axes[mid]] - Coords(p)[axes[mid]];
+		if (diff < 0 || diff * diff <= radius2)
+			SearchWithin(lo, mid, q, radius2, min_beds, found);
+		if (diff >= 0 || diff * diff <= radius2)
+			SearchWithin(mid + 1, hi, q, radius2, min_beds, found);
+	}
+};
+
+// Running totals per city and per hospital: free beds,
+// average rating and the lowest and median price. Every
+// change adjusts them by its delta, so a reader gets any
+// total in O(1) without scanning the city's hospitals.
+//
+// The stats observe the table they are built from, so
+// every change made through it, from bookings written
+// back to ratings, prices, added hospitals and log
+// replay, reaches the totals. The table must outlive
+// the stats.
+//
+// Readers never lock: each total is an atomic that is
+// published after every change. Bed counts change from
+// many booking threads at once through AddBeds, which is
+// a pair of atomic adds. Rating and price changes are
+// rarer and serialize on a writer mutex that readers do
+// not touch, because the median needs the city's prices
+// in order. Each total is current on its own, but a
+// city's totals are published one at a time, so reading
+// several of them can mix values from before and after
+// the same change, e.g. a new hospital in the count but
+// not yet in the average. Adding a hospital, like adding
+// to the table, needs the stats to itself.
+class OccupancyStats : public HospitalTable::Observer {
+public:
+	explicit OccupancyStats(HospitalTable& hospitals)
+		: table(hospitals), prices(hospitals.CityCount()),
+		  rating_sums(hospitals.CityCount())
+	{
+		cities.resize(hospitals.CityCount());
+		for (uint32_t i = 0; i < hospitals.Size(); i++) {
+			AddRow(hospitals, i);
+			prices[rows[i].city].push_back(hospitals.Prices()[i]);
+		}
+		for (uint32_t c = 0; c < cities.size(); c++) {
+			sort(prices[c].begin(), prices[c].end());
+			PublishCity(c);
+		}
+		table.AddObserver(this);
+	}
+
+	OccupancyStats(const OccupancyStats&) = delete;
+	OccupancyStats& operator=(const OccupancyStats&) = delete;
+
+	~OccupancyStats()
+	{
+		table.RemoveObserver(this);
+	}
+
+	// Takes (delta < 0) or gives back beds in a hospital.
+	// Safe from any number of threads.
+	void AddBeds(uint32_t row, int delta)
+	{
+		rows[row].free.fetch_add(delta, memory_order_acq_rel);
+		cities[rows[row].city].free.fetch_add(delta, memory_order_acq_rel);
+	}
+
+	void HospitalAdded(const HospitalTable& hospitals, uint32_t row) override
+	{
+		lock_guard<mutex> lock(writer);
+		AddRow(hospitals, row);
+		uint32_t city = rows[row].city;
+		int value = hospitals.Prices()[row];
+		vector<int>& sorted = prices[city];
+		sorted.insert(upper_bound(sorted.begin(), sorted.end(), value),
+			value);
+		PublishCity(city);
+	}
+
+	// A table write-back of counts that bookings already
+	// moved here changes nothing
+	void BedsSet(uint32_t row, int beds) override
+	{
+		int old = rows[row].free.exchange(beds, memory_order_acq_rel);
+		cities[rows[row].city].free.fetch_add(beds - old,
+			memory_order_acq_rel);
+	}
+
+	void RatingSet(uint32_t row, float value) override
+	{
+		lock_guard<mutex> lock(writer);
+		uint32_t city = rows[row].city;
+		float old = rows[row].rating.exchange(value, memory_order_relaxed);
+		rating_sums[city] += double(value) - old;
+		PublishCity(city);
+	}
+
+	void PriceSet(uint32_t row, int value) override
+	{
+		lock_guard<mutex> lock(writer);
+		uint32_t city = rows[row].city;
+		int old = rows[row].price.exchange(value, memory_order_relaxed);
+		vector<int>& sorted = prices[city];
+		sorted.erase(lower_bound(sorted.begin(), sorted.end(), old));
+		sorted.insert(upper_bound(sorted.begin(), sorted.end(), value),
+			value);
+		PublishCity(city);
+	}
+
+	// Per hospital
+	int FreeBeds(uint32_t row) const
+	{
+		return rows[row].free.load(memory_order_acquire);
+	}
+
+	// Per city, by HospitalTable city id
+	long long CityFreeBeds(uint32_t city) const
+	{
+		return cities[city].free.load(memory_order_acquire);
+	}
+
+	uint32_t CityHospitals(uint32_t city) const
+	{
+		return cities[city].hospitals.load(memory_order_acquire);
+	}
+
+	float CityAverageRating(uint32_t city) const
+	{
+		return cities[city].average_rating.load(memory_order_acquire);
+	}
+
+	int CityMinPrice(uint32_t city) const
+	{
+		return cities[city].min_price.load(memory_order_acquire);
+	}
+
+	// The lower middle price when the count is even
+	int CityMedianPrice(uint32_t city) const
+	{
+		return cities[city].median_price.load(memory_order_acquire);
+	}
+
+	size_t Size() const
+	{
+		return rows.size();
+	}
+
+	size_t CityCount() const
+	{
+		return cities.size();
+	}
+
+private:
+	struct RowSlot {
+		uint32_t city;
+		atomic<int> free;
+		atomic<float> rating;
+		atomic<int> price;
+	};
+
+	// Hot counters of different cities on separate
+	// cache lines
+	struct alignas(64) CitySlot {
+		atomic<long long> free{ 0 };
+		atomic<uint32_t> hospitals{ 0 };
+		atomic<float> average_rating{ 0 };
+		atomic<int> min_price{ 0 };
+		atomic<int> median_price{ 0 };
+	};
+
+	HospitalTable& table;
+
+	// Slots never move once made, so counters stay put
+	// while rows and cities are added
+	deque<RowSlot> rows;
+	deque<CitySlot> cities;
+
+	// Writer side, under the mutex
+	mutex writer;
+	vector<vector<int>> prices; // per city, ascending
+	vector<double> rating_sums;
+
+	// Counts a hospital in its row and city, all but
+	// its price
+	void AddRow(const HospitalTable& hospitals, uint32_t row)
+	{
+		uint32_t city = hospitals.CityId(row);
+		if (city >= cities.size()) {
+			cities.resize(city + 1);
+			prices.resize(city + 1);
+			rating_sums.resize(city + 1);
+		}
+		rows.emplace_back();
+		RowSlot& slot = rows.back();
+		slot.city = city;
+		slot.free.store(hospitals.Beds()[row], memory_order_relaxed);
+		slot.rating.store(hospitals.Ratings()[row], memory_order_relaxed);
+		slot.price.store(hospitals.Prices()[row], memory_order_relaxed);
+		cities[city].free.fetch_add(hospitals.Beds()[row],
+			memory_order_relaxed);
+		rating_sums[city] += hospitals.Ratings()[row];
+	}
+
+	void PublishCity(uint32_t city)
+	{
+		const vector<int>& sorted = prices[city];
+		CitySlot& slot = cities[city];
+		if (sorted.empty())
+			return;
+		slot.hospitals.store(sorted.size(), memory_order_release);
+		slot.average_rating.store(rating_sums[city] / sorted.size(),
+			memory_order_release);
+		slot.min_price.store(sorted.front(), memory_order_release);
+		slot.median_price.store(sorted[(sorted.size() - 1) / 2],
+			memory_order_release);
+	}
+};
+
+// Concurrent bed booking. Every hospital has its own
+// free bed counter on its own cache line, and reserving
+// or releasing is a compare-and-swap on that counter
+// alone. Admission threads never wait on a shared lock,
+// and a reservation only succeeds while the counter is
+// above zero, so a hospital can never be overbooked.
+// Given an OccupancyStats, every booking also moves its
+// city and hospital totals.
+class BedBookingEngine {
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	explicit BedBookingEngine(const HospitalTable& hospitals,
+		OccupancyStats* stats = nullptr)
+		: count(hospitals.Size()), slots(new Slot[hospitals.Size()]),
+		  stats(stats)
+	{
+		for (size_t i = 0; i < count; i++)
+			slots[i].free.store(hospitals.Beds()[i],
+				memory_order_relaxed);
+	}
+
+	// Takes one bed in the hospital, false when it is full
+	bool Reserve(uint32_t row)
+	{
+		atomic<int>& free = slots[row].free;
+		int beds = free.load(memory_order_relaxed);
+		while (beds > 0) {
+			if (free.compare_exchange_weak(beds, beds - 1,
+					memory_order_acq_rel, memory_order_relaxed)) {
+				if (stats)
+					stats->AddBeds(row, -1);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Books the first hospital in rows that has a free
+	// bed, e.g. walking a sorted view. Returns its row,
+	// or npos when every candidate is full.
+	uint32_t ReserveFirst(const vector<uint32_t>& rows)
+	{
+		for (uint32_t row : rows)
+			if (Reserve(row))
+				return row;
+		return npos;
+	}
+
+	// Gives a bed back on discharge or cancellation
+	void Release(uint32_t row)
+	{
+		slots[row].free.fetch_add(1, memory_order_acq_rel);
+		if (stats)
+			stats->AddBeds(row, 1);
+	}
+
+	int FreeBeds(uint32_t row) const
+	{
+		return slots[row].free.load(memory_order_acquire);
+	}
+
+	size_t Size() const
+	{
+		return count;
+	}
+
+	// Writes the counters back into the table, through the
+	// setters so its sorted views stay correct. Call it
+	// from one thread once no booking is in flight.
+	void Commit(HospitalTable& hospitals) const
+	{
+		for (uint32_t i = 0; i < count; i++)
+			if (hospitals.Beds()[i] != FreeBeds(i))
+				hospitals.SetBeds(i, FreeBeds(i));
+	}
+
+private:
+	struct alignas(64) Slot {
+		atomic<int> free;
+	};
+
+	size_t count;
+	unique_ptr<Slot[]> slots;
+	OccupancyStats* stats;
+};
+
+// Weights of the patient to hospital assignment cost:
+//   price * price_per_bed - rating * rating
+//   + distance * distance(patient city, hospital city)
+struct AssignmentWeights {
+	double price = 1.0;
+	double rating = 50.0;
+	double distance = 1.0; // per km
+};
+
+// Distance in km between two city ids of a
+// HospitalTable. A patient city that is not in the
+// table is passed as StringPool::npos.
+typedef function<double(uint32_t, uint32_t)> CityDistance;
+
+// Great circle distance between city centres, each the
+// mean position of the city's hospitals that have
+// coordinates. A city with no known position, or a
+// patient city with no hospitals, is fallback_km from
+// every other city.
+class CityCentreDistance {
+public:
+	explicit CityCentreDistance(const HospitalTable& hospitals,
+		double fallback_km = 500)
+		: fallback_km(fallback_km),
+		  centres(hospitals.CityCount(), { NAN, NAN })
+	{
+		vector<array<double, 3>> sums(hospitals.CityCount());
+		for (uint32_t row = 0; row < hospitals.Size(); row++) {
+			float lat = hospitals.Latitudes()[row];
+			float lon = hospitals.Longitudes()[row];
+			if (isnan(lat) || isnan(lon))
+				continue;
+			double phi = lat * M_PI / 180, lambda = lon * M_PI / 180;
+			array<double, 3>& sum = sums[hospitals.CityId(row)];
+			sum[0] += cos(phi) * cos(lambda);
+			sum[1] += cos(phi) * sin(lambda);
+			sum[2] += sin(phi);
+		}
+		for (uint32_t city = 0; city < sums.size(); city++) {
+			const array<double, 3>& sum = sums[city];
+			double norm = sqrt(sum[0] * sum[0] + sum[1] * sum[1]
+				+ sum[2] * sum[2]);
+			// No coordinates, or hospitals on opposite sides
+			// of the earth with no meaningful centre
+			if (norm < 1e-9)
+				continue;
+			centres[city] = { (float)(asin(sum[2] / norm) * 180 / M_PI),
+				(float)(atan2(sum[1], sum[0]) * 180 / M_PI) };
+		}
+	}
+
+	double operator()(uint32_t from, uint32_t to) const
+	{
+		if (from == to)
+			return 0;
+		if (from >= centres.size() || to >= centres.size()
+			|| isnan(centres[from].first) || isnan(centres[to].first))
+			return fallback_km;
+		return HospitalLocator::DistanceKm(centres[from].first,
+			centres[from].second, centres[to].first, centres[to].second);
+	}
+
+private:
+	double fallback_km;
+	vector<pair<float, float>> centres; // lat, lon; NAN when unknown
+};
+
+// Minimum cost assignment of waiting patients to free
+// beds, as a min-cost flow solved by successive shortest
+// paths with potentials.
+//
+// The cost only depends on the patient's city and the
+// hospital, so patients of one city are interchangeable
+// and become a single source node. Inside a hospital city
+// every patient prefers the same hospitals in the same
+// order (price and rating do not depend on where the
+// patient comes from), so an optimal plan always fills a
+// city's cheapest hospitals first. Each hospital city is
+// then one node whose edge to the sink costs the next
+// free bed in that order. The graph has one node per city
+// instead of one per patient and per hospital, and each
+// shortest path search is O((C + G)^2) for C patient
+// cities and G hospital cities.
+//
+// Only the cost matrix is built in parallel. The solve
+// stays serial: each augmenting path depends on the flows
+// and potentials left by the one before, and a single
+// search over the city graph is too small to split
+// across threads for less than it costs to sync them.
+class PatientAssigner {
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	// Without a distance function, cities are as far apart
+	// as their hospitals' coordinates put them
+	PatientAssigner(const HospitalTable& hospitals,
+		AssignmentWeights weights = AssignmentWeights(),
+		CityDistance distance = nullptr)
+		: hospitals(hospitals), weights(weights),
+		  distance(distance ? distance : CityCentreDistance(hospitals))
+	{
+	}
+
+	// Hospital row for every patient, given the city id of
+	// each patient, or npos for patients left without a
+	// bed. As many patients as there are free beds get one.
+	vector<uint32_t> Assign(const vector<uint32_t>& patient_cities)
+	{
+		BuildSources(patient_cities);
+		BuildSinks();
+		BuildCosts();
+		Solve();
+		return Expand(patient_cities);
+	}
+
+	// Total cost of an assignment under these weights
+	double Cost(const vector<uint32_t>& patient_cities,
+		const vector<uint32_t>& rows) const
+	{
+		double total = 0;
+		for (size_t i = 0; i < rows.size(); i++)
+			if (rows[i] != npos)
+				total += BedCost(rows[i]) + weights.distance
+					* distance(patient_cities[i], hospitals.CityId(rows[i]));
+		return total;
+	}
+
+private:
+	const HospitalTable& hospitals;
+	AssignmentWeights weights;
+	CityDistance distance;
+
+	vector<uint32_t> source_city; // patient city of each source
+	vector<long long> supply; // patients still waiting per source
+
+	vector<uint32_t> sink_city; // hospital city of each sink
+	vector<vector<uint32_t>> beds_order; // rows, cheapest bed first
+	vector<size_t> next_bed; // first hospital with room, per sink
+	vector<int> room; // free beds left per hospital row
+
+	vector<double> cost; // source x sink distance cost
+	vector<long long> flow; // source x sink patients sent
+
+	double BedCost(uint32_t row) const
+	{
+		return weights.price * hospitals.Prices()[row]
+			- weights.rating * hospitals.Ratings()[row];
+	}
+
+	void BuildSources(const vector<uint32_t>& patient_cities)
+	{
+		unordered_map<uint32_t, uint32_t> index;
+		source_city.clear();
+		supply.clear();
+		for (uint32_t city : patient_cities) {
+			auto found = index.emplace(city, source_city.size());
+			if (found.second) {
+				source_city.push_back(city);
+				supply.push_back(0);
+			}
+			supply[found.first->second]++;
+		}
+	}
+
+	void BuildSinks()
+	{
+		sink_city.clear();
+		beds_order.clear();
+		room.assign(hospitals.Beds().begin(), hospitals.Beds().end());
+		for (uint32_t city = 0; city < hospitals.CityCount(); city++) {
+			vector<uint32_t> rows;
+			for (uint32_t row : hospitals.RowsInCity(city))
+				if (room[row] > 0)
+					rows.push_back(row);
+			if (rows.empty())
+				continue;
+			sort(rows.begin(), rows.end(), [&](uint32_t a, uint32_t b) {
+				return BedCost(a) != BedCost(b) ? BedCost(a) < BedCost(b)
+					: a < b;
+			});
+			sink_city.push_back(city);
+			beds_order.push_back(move(rows));
+		}
+		next_bed.assign(sink_city.size(), 0);
+	}
+
+	// Every entry is a great circle distance by default,
+	// a few trig calls each, so rows of the matrix are
+	// filled by one thread each, striding over the sources
+	void BuildCosts()
+	{
+		size_t sources = source_city.size(), sinks = sink_city.size();
+		cost.assign(sources * sinks, 0);
+		flow.assign(sources * sinks, 0);
+
+		size_t threads = min<size_t>(sources,
+			max(1u, thread::hardware_concurrency()));
+		vector<thread> workers;
+		for (size_t t = 0; t < threads; t++) {
+			workers.emplace_back([&, t] {
+				for (size_t s = t; s < sources; s += threads)
+					for (size_t k = 0; k < sinks; k++)
+						cost[s * sinks + k] = weights.distance
+							* distance(source_city[s], sink_city[k]);
+			});
+		}
+		for (thread& worker : workers)
+			worker.join();
+	}
+
+	// Bed costs are shifted so the cheapest is zero. Every
+	// plan moves the same number of patients, so the shift
+	// does not change which plan is optimal, and it keeps
+	// all first-round edge costs non-negative for Dijkstra.
+	void Solve()
+	{
+		size_t sources = source_city.size(), sinks = sink_city.size();
+		if (sources == 0 || sinks == 0)
+			return;
+
+		double base = numeric_limits<double>::max();
+		for (const vector<uint32_t>& rows : beds_order)
+			base = min(base, BedCost(rows.front()));
+		auto sink_edge = [&](size_t k) {
+			return BedCost(beds_order[k][next_bed[k]]) - base;
+		};
+
+		// Nodes: sources 0..S-1, sinks S..S+K-1, then the sink
+		const size_t nodes = sources + sinks + 1, target = nodes - 1;
+		const double inf = numeric_limits<double>::infinity();
+		vector<double> potential(nodes, 0), dist(nodes);
+		vector<size_t> parent(nodes);
+		vector<bool> done(nodes);
+
+		while (true) {
+			fill(dist.begin(), dist.end(), inf);
+			fill(done.begin(), done.end(), false);
+			// Sources with waiting patients hang off an
+			// implicit super source at distance zero
+			for (size_t s = 0; s < sources; s++)
+				if (supply[s] > 0) {
+					dist[s] = 0;
+					parent[s] = nodes;
+				}
+			// Dense Dijkstra, the graph is nearly complete
+			while (true) {
+				size_t u = nodes;
+				for (size_t v = 0; v < nodes; v++)
+					if (!done[v] && dist[v] < inf
+						&& (u == nodes || dist[v] < dist[u]))
+						u = v;
+				if (u == nodes || u == target)
+					break;
+				done[u] = true;
+
+				auto relax = [&](size_t v, double edge) {
+					double d = dist[u] + edge + potential[u] - potential[v];
+					if (d < dist[v] - 1e-9) {
+						dist[v] = d;
+						parent[v] = u;
+					}
+				};
+				if (u < sources) {
+					for (size_t k = 0; k < sinks; k++)
+						relax(sources + k, cost[u * sinks + k]);
+				}
+				else {
+					size_t k = u - sources;
+					for (size_t s = 0; s < sources; s++)
+						if (flow[s * sinks + k] > 0)
+							relax(s, -cost[s * sinks + k]);
+					if (next_bed[k] < beds_order[k].size())
+						relax(target, sink_edge(k));
+				}
+			}
+			if (dist[target] == inf)
+				break;
+
+			// Capping at the sink's distance keeps reduced
+			// costs non-negative for nodes Dijkstra did not
+			// settle before it stopped
+			for (size_t v = 0; v < nodes; v++)
+				potential[v] += min(dist[v], dist[target]);
+
+			// Bottleneck along sink -> ... -> source
+			size_t last = parent[target];
+			long long amount = room[beds_order[last - sources]
+				[next_bed[last - sources]]];
+			size_t v = last;
+			while (true) {
+				size_t s = parent[v];
+				if (parent[s] == nodes) {
+					amount = min(amount, supply[s]);
+					break;
+				}
+				amount = min(amount, flow[s * sinks + (parent[s] - sources)]);
+				v = parent[s];
+			}
+
+			// Apply it: forward on source -> sink edges,
+			// cancelling on sink -> source edges
+			size_t k = last - sources;
+			uint32_t row = beds_order[k][next_bed[k]];
+			room[row] -= amount;
+			if (room[row] == 0)
+				next_bed[k]++;
+			v = last;
+			while (true) {
+				size_t s = parent[v];
+				flow[s * sinks + (v - sources)] += amount;
+				if (parent[s] == nodes) {
+					supply[s] -= amount;
+					break;
+				}
+				flow[s * sinks + (parent[s] - sources)] -= amount;
+				v = parent[s];
+			}
+		}
+	}
+
+	// Turns per-city flows back into one row per patient.
+	// Each sink's used beds are handed out cheapest first
+	// to the sources that sent patients there.
+	vector<uint32_t> Expand(const vector<uint32_t>& patient_cities)
+	{
+		size_t sources = source_city.size(), sinks = sink_city.size();
+		vector<vector<uint32_t>> beds_for(sources);
+		for (size_t k = 0; k < sinks; k++) {
+			size_t cursor = 0;
+			int left = 0;
+			for (size_t s = 0; s < sources; s++) {
+				for (long long n = flow[s * sinks + k]; n > 0; n--) {
+					while (left == 0) {
+						uint32_t row = beds_order[k][cursor++];
+						left = hospitals.Beds()[row] - room[row];
+					}
+					beds_for[s].push_back(beds_order[k][cursor - 1]);
+					left--;
+				}
+			}
+		}
+
+		unordered_map<uint32_t, uint32_t> index;
+		for (size_t s = 0; s < sources; s++)
+			index[source_city[s]] = s;
+		vector<uint32_t> rows(patient_cities.size(), npos);
+		vector<size_t> taken(sources);
+		for (size_t i = 0; i < patient_cities.size(); i++) {
+			uint32_t s = index[patient_cities[i]];
+			if (taken[s] < beds_for[s].size())
+				rows[i] = beds_for[s][taken[s]++];
+		}
+		return rows;
+	}
+};
+
+// On-disk format. All integers are native byte order.
+// The file is laid out as
+//   FileHeader
+//   HospitalRecord[hospital_count]
+//   PatientRecord[patient_count]
+//   string heap
+// Every distinct string is stored once in the heap as a
+// uint32_t length followed by its bytes, and records hold
+// heap offsets. Records are fixed width, so row i is at a
+// known offset and can be read in place.
+const char HMT_MAGIC[8] = { 'H', 'M', 'T', 'D', 'A', 'T', 'A', '\0' };
+const uint32_t HMT_FORMAT_VERSION = 2; // 2 added coordinates
+
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint64_t hospital_count;
+	uint64_t patient_count;
+	uint64_t hospitals_offset;
+	uint64_t patients_offset;
+	uint64_t strings_offset;
+	uint64_t strings_size;
+	uint64_t checkpoint_seq; // last log record in this snapshot
+	uint64_t generation; // log written after this snapshot, 0 for none
+	uint64_t reserved[6]; // zero, for later versions
+};
+
+struct HospitalRecord {
+	uint32_t name;
+	uint32_t location;
+	uint32_t contact;
+	uint32_t doctor_name;
+	int32_t available_beds;
+	float rating;
+	int32_t price;
+	uint32_t reserved;
+	float latitude;
+	float longitude;
+};
+
+struct PatientRecord {
+	uint32_t name;
+	uint32_t contact;
+	uint32_t location;
+	int32_t id;
+	int32_t expenditure;
+	uint32_t hospital; // hospital row, UINT32_MAX if none
+	uint32_t reserved[2];
+};
+
+static_assert(sizeof(FileHeader) == 128, "FileHeader layout");
+static_assert(sizeof(HospitalRecord) == 40, "HospitalRecord layout");
+static_assert(sizeof(PatientRecord) == 32, "PatientRecord layout");
+
+// A whole file mapped read-only. Uses mmap on POSIX and
+// a file mapping object on Windows.
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		Close();
+	}
+
+	bool Open(const string& path)
+	{
+		Close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ,
+			FILE_SHARE_READ, NULL, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+			Close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL)
+			data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		size = file_size.QuadPart;
+#else
+		fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			Close();
+			return false;
+		}
+		size = st.st_size;
+		void* mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		data = mapped == MAP_FAILED ? nullptr : (const char*)mapped;
+#endif
+		if (data == nullptr) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void Close()
+	{
+#ifdef _WIN32
+		if (data != nullptr)
+			UnmapViewOfFile(data);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data != nullptr)
+			munmap((void*)data, size);
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+	const char* Data() const
+	{
+		return data;
+	}
+
+	size_t Size() const
+	{
+		return size;
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int fd = -1;
+#endif
+	const char* data = nullptr;
+	size_t size = 0;
+};
+
+// Hospitals and patients kept in a binary data file.
+// Open only maps the file and checks the header, so it
+// takes the same time for ten records or ten million.
+// Records and strings are read straight from the mapping.
+//
+// The tables the program works on are not served from
+// the mapping. LoadTable and LoadPatients copy every
+// record into them and intern every string, so loading
+// still costs time and heap in proportion to the file;
+// what the mapping saves is the parsing, the read
+// buffers and a string per field.
+//
+// The file is a snapshot and is never written in place.
+// Changes since the snapshot live in the write-ahead log,
+// which replays them as deltas; records patched through
+// the mapping could reach the disk page by page and be
+// applied twice. Save writes a new snapshot instead.
+class HospitalStore {
+public:
+	static constexpr uint32_t npos = UINT32_MAX;
+
+	bool Open(const string& path, string* error = nullptr)
+	{
+		auto fail = [&](const string& why) {
+			if (error)
+				*error = path + ": " + why;
+			file.Close();
+			return false;
+		};
+		if (!file.Open(path))
+			return fail("cannot open");
+		if (file.Size() < sizeof(FileHeader))
+			return fail("too short");
+
+		const FileHeader& h = Header();
+		if (memcmp(h.magic, HMT_MAGIC, sizeof(HMT_MAGIC)) != 0)
+			return fail("not an hmt data file");
+		if (h.version != HMT_FORMAT_VERSION)
+			return fail("unsupported version " + to_string(h.version));
+		if (h.header_size != sizeof(FileHeader)
+			|| !Fits(h.hospitals_offset, h.hospital_count, sizeof(HospitalRecord))
+			|| !Fits(h.patients_offset, h.patient_count, sizeof(PatientRecord))
+			|| !Fits(h.strings_offset, h.strings_size, 1))
+			return fail("corrupt header");
+		return true;
+	}
+
+	void Close()
+	{
+		file.Close();
+	}
+
+	size_t HospitalCount() const
+	{
+		return Header().hospital_count;
+	}
+
+	// Sequence number of the last log record already
+	// contained in this file
+	uint64_t CheckpointSeq() const
+	{
+		return Header().checkpoint_seq;
+	}
+
+	// Generation of the log that continues this file
+	uint64_t Generation() const
+	{
+		return Header().generation;
+	}
+
+	size_t PatientCount() const
+	{
+		return Header().patient_count;
+	}
+
+	const HospitalRecord& HospitalAt(uint32_t row) const
+	{
+		return Hospitals()[row];
+	}
+
+	const PatientRecord& PatientAt(uint32_t row) const
+	{
+		return Patients()[row];
+	}
+
+	// A string from the heap, viewed in place. An
+	// offset outside the heap reads as empty.
+	string_view String(uint32_t offset) const
+	{
+		const FileHeader& h = Header();
+		uint32_t length;
+		if ((uint64_t)offset + sizeof(length) > h.strings_size)
+			return string_view();
+		const char* at = file.Data() + h.strings_offset + offset;
+		memcpy(&length, at, sizeof(length));
+		if (length > h.strings_size - offset - sizeof(length))
+			return string_view();
+		return string_view(at + sizeof(length), length);
+	}
+
+	// Builds the in-memory table with its indexes, one
+	// copied row per record. Strings are read from the
+	// mapping without temporaries, and since the heap
+	// stores each one once, a heap offset already seen
+	// maps straight to its interned id.
+	HospitalTable LoadTable() const
+	{
+		HospitalTable hospitals;
+		hospitals.Reserve(HospitalCount());
+		unordered_map<uint32_t, uint32_t> cities, doctors;
+		auto intern = [&](unordered_map<uint32_t, uint32_t>& seen,
+			uint32_t offset, uint32_t (HospitalTable::*add)(string_view)) {
+			auto found = seen.find(offset);
+			if (found != seen.end())
+				return found->second;
+			uint32_t id = (hospitals.*add)(String(offset));
+			seen.emplace(offset, id);
+			return id;
+		};
+		for (uint32_t i = 0; i < HospitalCount(); i++) {
+			const HospitalRecord& r = HospitalAt(i);
+			hospitals.AddInterned(hospitals.InternName(String(r.name)),
+				intern(cities, r.location, &HospitalTable::InternCity),
+				intern(doctors, r.doctor_name, &HospitalTable::InternDoctor),
+				String(r.contact), r.available_beds, r.rating, r.price,
+				r.latitude, r.longitude);
+		}
+		return hospitals;
+	}
+
+	PatientTable LoadPatients() const
+	{
+		PatientTable patients;
+		patients.Reserve(PatientCount());
+		for (uint32_t i = 0; i < PatientCount(); i++) {
+			const PatientRecord& r = PatientAt(i);
+			patients.AddPatient(String(r.name), r.id, String(r.contact),
+				String(r.location), r.expenditure,
+				r.hospital < HospitalCount() ? r.hospital : npos);
+		}
+		return patients;
+	}
+
+	// Writes a complete file next to path and renames it
+	// over path, so readers never see a half written file
+	static bool Save(const string& path, const HospitalTable& hospitals,
+		const PatientTable& patients, string* error = nullptr,
+		uint64_t checkpoint_seq = 0, uint64_t generation = 0)
+	{
+		string heap;
+		unordered_map<string_view, uint32_t> offsets;
+		auto intern = [&](string_view value) {
+			auto found = offsets.find(value);
+			if (found != offsets.end())
+				return found->second;
+			uint32_t offset = heap.size();
+			uint32_t length = value.size();
+			heap.append((const char*)&length, sizeof(length));
+			heap.append(value);
+			offsets.emplace(value, offset);
+			return offset;
+		};
+
+		vector<HospitalRecord> hospital_records(hospitals.Size());
+		for (uint32_t i = 0; i < hospitals.Size(); i++) {
+			HospitalRecord& r = hospital_records[i];
+			r = HospitalRecord();
+			r.name = intern(hospitals.Name(i));
+			r.location = intern(hospitals.Location(i));
+			r.contact = intern(hospitals.Contact(i));
+			r.doctor_name = intern(hospitals.Doctor(i));
+			r.available_beds = hospitals.Beds()[i];
+			r.rating = hospitals.Ratings()[i];
+			r.price = hospitals.Prices()[i];
+			r.latitude = hospitals.Latitudes()[i];
+			r.longitude = hospitals.Longitudes()[i];
+		}
+
+		vector<PatientRecord> patient_records(patients.Size());
+		for (uint32_t i = 0; i < patients.Size(); i++) {
+			PatientRecord& r = patient_records[i];
+			r = PatientRecord();
+			r.name = intern(patients.Name(i));
+			r.contact = intern(patients.Contact(i));
+			r.location = intern(patients.City(i));
+			r.id = patients.Id(i);
+			r.expenditure = patients.Expenditure(i);
+			r.hospital = patients.HospitalOf(i);
+		}
+
+		FileHeader h = FileHeader();
+		memcpy(h.magic, HMT_MAGIC, sizeof(HMT_MAGIC));
+		h.version = HMT_FORMAT_VERSION;
+		h.header_size = sizeof(FileHeader);
+		h.hospital_count = hospital_records.size();
+		h.patient_count = patient_records.size();
+		h.hospitals_offset = sizeof(FileHeader);
+		h.patients_offset = h.hospitals_offset
+			+ h.hospital_count * sizeof(HospitalRecord);
+		h.strings_offset = h.patients_offset
+			+ h.patient_count * sizeof(PatientRecord);
+		h.strings_size = heap.size();
+		h.checkpoint_seq = checkpoint_seq;
+		h.generation = generation;
+
+		string temp = path + ".tmp";
+		{
+			ofstream out(temp, ios::binary | ios::trunc);
+			out.write((const char*)&h, sizeof(h));
+			out.write((const char*)hospital_records.data(),
+				hospital_records.size() * sizeof(HospitalRecord));
+			out.write((const char*)patient_records.data(),
+				patient_records.size() * sizeof(PatientRecord));
+			out.write(heap.data(), heap.size());
+			out.flush();
+			if (!out) {
+				if (error)
+					*error = temp + ": write failed";
+				remove(temp.c_str());
+				return false;
+			}
+		}
+#ifdef _WIN32
+		// rename does not replace an existing file here
+		remove(path.c_str());
+#endif
+		if (rename(temp.c_str(), path.c_str()) != 0) {
+			if (error)
+				*error = path + ": " + strerror(errno);
+			return false;
+		}
+		return true;
+	}
+
+private:
+	MappedFile file;
+
+	const FileHeader& Header() const
+	{
+		return *(const FileHeader*)file.Data();
+	}
+
+	const HospitalRecord* Hospitals() const
+	{
+		return (const HospitalRecord*)(file.Data() + Header().hospitals_offset);
+	}
+
+	const PatientRecord* Patients() const
+	{
+		return (const PatientRecord*)(file.Data() + Header().patients_offset);
+	}
+
+	// Whether count items of size bytes from offset lie
+	// inside the file, without overflowing
+	bool Fits(uint64_t offset, uint64_t count, uint64_t size) const
+	{
+		return offset <= file.Size()
+			&& count <= (file.Size() - offset) / size
+			&& offset % alignof(uint64_t) == 0;
+	}
+};
+
+// Events in the write-ahead log
+enum WalEventType {
+	WAL_ADMIT = 1, // a = patient, b = hospital
+	WAL_DISCHARGE = 2, // a = patient
+	WAL_SET_BEDS = 3 // a = hospital, b = free beds
+};
+
+struct WalRecord {
+	uint64_t seq;
+	uint32_t type;
+	uint32_t a;
+	int32_t b;
+	uint32_t checksum; // FNV-1a of the fields above
+};
+
+static_assert(sizeof(WalRecord) == 24, "WalRecord layout");
+
+const char HMT_WAL_MAGIC[8] = { 'H', 'M', 'T', 'W', 'A', 'L', '2', '\0' };
+
+// Starts the log. The generation pairs it with the data
+// file saved just before it, so a log left over from
+// another snapshot is never replayed.
+struct WalHeader {
+	char magic[8];
+	uint64_t generation;
+};
+
+static_assert(sizeof(WalHeader) == 16, "WalHeader layout");
+
+// A fresh nonzero log generation
+uint64_t NewWalGeneration()
+{
+	random_device device;
+	uint64_t generation = 0;
+	while (generation == 0)
+		generation = ((uint64_t)device() << 32 | device())
+			^ chrono::steady_clock::now().time_since_epoch().count();
+	return generation;
+}
+
+uint32_t WalChecksum(const WalRecord& r)
+{
+	const unsigned char* bytes = (const unsigned char*)&r;
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < offsetof(WalRecord, checksum); i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+// Applies one logged event to the tables. False when
+// the event does not fit them: rows they do not have, or
+// an admission to a full hospital or of a patient who
+// is in another one. Applying an admission twice is a
+// no-op, so is a discharge.
+bool ApplyWalRecord(const WalRecord& r, HospitalTable& hospitals,
+	PatientTable& patients)
+{
+	switch (r.type) {
+	case WAL_ADMIT:
+		if (r.a >= patients.Size() || (uint32_t)r.b >= hospitals.Size())
+			return false;
+		if (patients.HospitalOf(r.a) == (uint32_t)r.b)
+			return true;
+		if (patients.HospitalOf(r.a) != PatientTable::npos
+			|| hospitals.Beds()[r.b] <= 0)
+			return false;
+		patients.SetHospital(r.a, r.b);
+		hospitals.SetBeds(r.b, hospitals.Beds()[r.b] - 1);
+		return true;
+	case WAL_DISCHARGE: {
+		if (r.a >= patients.Size())
+			return false;
+		uint32_t row = patients.HospitalOf(r.a);
+		if (row != PatientTable::npos) {
+			patients.SetHospital(r.a, PatientTable::npos);
+			hospitals.SetBeds(row, hospitals.Beds()[row] + 1);
+		}
+		return true;
+	}
+	case WAL_SET_BEDS:
+		if (r.a >= hospitals.Size())
+			return false;
+		hospitals.SetBeds(r.a, r.b);
+		return true;
+	}
+	return false;
+}
+
+// Durable log of admissions, discharges and bed count
+// changes, written ahead of the in-memory update.
+//
+// Append returns once the event is on disk, but the
+// events of concurrent writers share one write and one
+// fsync: whichever writer finds no flush running takes
+// every pending record and syncs them together, and the
+// others wait for it. Under load each fsync covers many
+// events.
+//
+// The data file is the snapshot. Saving it records the
+// last logged sequence number as its checkpoint and a new
+// generation, and the log is then reset to that
+// generation. Recovery loads the snapshot and replays
+// only the records after its checkpoint, from a log of
+// the same generation.
+class WriteAheadLog {
+public:
+	WriteAheadLog() = default;
+	WriteAheadLog(const WriteAheadLog&) = delete;
+	WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+	~WriteAheadLog()
+	{
+		Close();
+	}
+
+	// Reads the log at path and calls apply for every
+	// record after checkpoint, in order. A log of another
+	// generation belongs to a different snapshot and is
+	// skipped. A missing log, or one cut short inside its
+	// header, holds nothing yet and is skipped too. A torn
+	// or corrupt tail from a crash ends the log and is cut
+	// off. last_seq is set to the newest sequence seen.
+	template <typename Apply>
+	static bool Replay(const string& path, uint64_t generation,
+		uint64_t checkpoint, Apply apply, uint64_t& last_seq,
+		string* error = nullptr)
+	{
+		last_seq = checkpoint;
+		ifstream in(path, ios::binary);
+		if (!in)
+			return true;
+
+		WalHeader header;
+		if (!in.read((char*)&header, sizeof(header)))
+			return true;
+		if (memcmp(header.magic, HMT_WAL_MAGIC, sizeof(header.magic)) != 0) {
+			if (error)
+				*error = path + ": not an hmt log";
+			return false;
+		}
+		if (header.generation != generation)
+			return true;
+
+		uint64_t good_bytes = sizeof(header);
+		uint64_t previous = 0;
+		WalRecord r;
+		while (in.read((char*)&r, sizeof(r))) {
+			if (r.checksum != WalChecksum(r) || r.seq <= previous)
+				break;
+			previous = r.seq;
+			// Older records are already in the snapshot
+			if (r.seq > checkpoint) {
+				if (!apply(r)) {
+					if (error)
+						*error = path + ": record "
+							+ to_string(r.seq) + " does not match the data";
+					return false;
+				}
+				last_seq = r.seq;
+			}
+			good_bytes += sizeof(r);
+		}
+		in.close();
+
+		error_code ec;
+		if (filesystem::file_size(path, ec) != good_bytes)
+			filesystem::resize_file(path, good_bytes, ec);
+		return true;
+	}
+
+	// Opens the log for appending after last_seq. A
+	// missing or short log, or one of another generation,
+	// is started over.
+	bool Open(const string& path, uint64_t generation, uint64_t last_seq,
+		string* error = nullptr)
+	{
+		Close();
+		this->path = path;
+		this->generation = generation;
+		this->last_seq = durable = last_seq;
+		failed = false;
+
+		WalHeader header;
+		ifstream in(path, ios::binary);
+		bool fresh = !in.read((char*)&header, sizeof(header))
+			|| memcmp(header.magic, HMT_WAL_MAGIC, sizeof(header.magic)) != 0
+			|| header.generation != generation;
+		in.close();
+		if (fresh)
+			failed = !StartFile();
+		else
+			file = fopen(path.c_str(), "ab");
+		if (file == nullptr || failed) {
+			if (error)
+				*error = path + ": cannot open log";
+			return false;
+		}
+		return true;
+	}
+
+	// Logs an event and waits until it is durable.
+	// Returns its sequence number, or 0 if the log
+	// could not be written.
+	uint64_t Append(WalEventType type, uint32_t a, int32_t b = 0)
+	{
+		unique_lock<mutex> lock(m);
+		if (failed || file == nullptr)
+			return 0;
+
+		WalRecord r = WalRecord();
+		r.seq = ++last_seq;
+		r.type = type;
+		r.a = a;
+		r.b = b;
+		r.checksum = WalChecksum(r);
+		pending.push_back(r);
+
+		while (durable < r.seq && !failed) {
+			if (flushing) {
+				flushed.wait(lock);
+				continue;
+			}
+			flushing = true;
+			vector<WalRecord> batch;
+			batch.swap(pending);
+			lock.unlock();
+			bool ok = fwrite(batch.data(), sizeof(WalRecord), batch.size(),
+						  file) == batch.size()
+				&& Sync();
+			lock.lock();
+			flushing = false;
+			syncs++;
+			if (ok)
+				durable = batch.back().seq;
+			else
+				failed = true;
+			flushed.notify_all();
+		}
+		return failed ? 0 : r.seq;
+	}
+
+	// Empties the log once a snapshot holds everything
+	// in it, and starts the snapshot's generation.
+	// Sequence numbers keep counting up.
+	bool Reset(uint64_t generation)
+	{
+		lock_guard<mutex> lock(m);
+		Close();
+		this->generation = generation;
+		failed = !StartFile();
+		return !failed;
+	}
+
+	uint64_t LastSeq()
+	{
+		lock_guard<mutex> lock(m);
+		return last_seq;
+	}
+
+	// Number of write + fsync rounds so far
+	uint64_t Syncs()
+	{
+		lock_guard<mutex> lock(m);
+		return syncs;
+	}
+
+	void Close()
+	{
+		if (file != nullptr)
+			fclose(file);
+		file = nullptr;
+	}
+
+private:
+	string path;
+	uint64_t generation = 0;
+	FILE* file = nullptr;
+	mutex m;
+	condition_variable flushed;
+	vector<WalRecord> pending;
+	uint64_t last_seq = 0; // last sequence handed out
+	uint64_t durable = 0; // last sequence known to be on disk
+	uint64_t syncs = 0;
+	bool flushing = false;
+	bool failed = false;
+
+	// Writes a log holding only the header next to path,
+	// syncs it and renames it over path, then opens it for
+	// appending. A crash leaves either the old log or the
+	// new one, never an empty file.
+	bool StartFile()
+	{
+		string temp = path + ".tmp";
+		FILE* out = fopen(temp.c_str(), "wb");
+		if (out == nullptr)
+			return false;
+		WalHeader header = WalHeader();
+		memcpy(header.magic, HMT_WAL_MAGIC, sizeof(header.magic));
+		header.generation = generation;
+		bool ok = fwrite(&header, sizeof(header), 1, out) == 1 && Sync(out);
+		ok = fclose(out) == 0 && ok;
+#ifdef _WIN32
+		// rename does not replace an existing file here
+		if (ok)
+			remove(path.c_str());
+#endif
+		if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+			remove(temp.c_str());
+			return false;
+		}
+		file = fopen(path.c_str(), "ab");
+		return file != nullptr;
+	}
+
+	bool Sync()
+	{
+		return Sync(file);
+	}
+
+	static bool Sync(FILE* f)
+	{
+		if (fflush(f) != 0)
+			return false;
+#ifdef _WIN32
+		return _commit(_fileno(f)) == 0;
+#else
+		return fsync(fileno(f)) == 0;
+#endif
+	}
+};
+
+// A CSV row that could not be loaded
+struct CsvError {
+	size_t line; // 1-based line in the file
+	string reason;
+};
+
+// What a CSV import did and how fast
+struct ImportStats {
+	size_t bytes = 0;
+	size_t rows = 0;
+	vector<CsvError> errors;
+	double seconds = 0;
+
+	double GBps() const
+	{
+		return seconds > 0 ? bytes / seconds / 1e9 : 0;
+	}
+};
+
+// Splits one CSV line into fields viewing the line, and
+// returns how many there are (max + 1 if more than max).
+// Quoted fields may hold commas. Only a field with a
+// doubled quote inside is copied, into scratch, to undo
+// the escaping. Fields cannot span lines.
+size_t SplitCsvLine(string_view line, string_view* fields, size_t max,
+	deque<string>& scratch)
+{
+	size_t count = 0, pos = 0;
+	while (true) {
+		if (count == max)
+			return max + 1;
+
+		string_view field;
+		if (pos < line.size() && line[pos] == '"') {
+			size_t begin = ++pos;
+			bool escaped = false;
+			while (pos < line.size()) {
+				if (line[pos] == '"') {
+					if (pos + 1 < line.size() && line[pos + 1] == '"') {
+						escaped = true;
+						pos += 2;
+						continue;
+					}
+					break;
+				}
+				pos++;
+			}
+			field = line.substr(begin, pos - begin);
+			if (escaped) {
+				string unescaped;
+				for (size_t i = 0; i < field.size(); i++) {
+					unescaped += field[i];
+					if (field[i] == '"')
+						i++;
+				}
+				scratch.push_back(move(unescaped));
+				field = scratch.back();
+			}
+			pos = min(line.find(',', pos), line.size());
+		}
+		else {
+			size_t comma = min(line.find(',', pos), line.size());
+			field = line.substr(pos, comma - pos);
+			pos = comma;
+		}
+
+		fields[count++] = field;
+		if (pos >= line.size())
+			return count;
+		pos++;
+	}
+}
+
+// Parses a whole field as a number, ignoring spaces
+// around it, with no allocation and no locale
+template <typename T>
+bool ParseNumber(string_view field, T& value)
+{
+	while (!field.empty() && field.front() == ' ')
+		field.remove_prefix(1);
+	while (!field.empty() && field.back() == ' ')
+		field.remove_suffix(1);
+	auto result = from_chars(field.data(), field.data() + field.size(), value);
+	return result.ec == errc() && result.ptr == field.data() + field.size()
+		&& !field.empty();
+}
+
+// Splits data into up to parts ranges of about equal
+// size, each starting at the beginning of a line
+vector<pair<size_t, size_t>> SplitLines(string_view data, size_t parts)
+{
+	vector<pair<size_t, size_t>> ranges;
+	size_t begin = 0;
+	for (size_t i = 1; i <= parts && begin < data.size(); i++) {
+		size_t end = i == parts ? data.size()
+			: max(begin, data.size() / parts * i);
+		if (end < data.size()) {
+			size_t eol = data.find('\n', end);
+			end = eol == string_view::npos ? data.size() : eol + 1;
+		}
+		ranges.emplace_back(begin, end);
+		begin = end;
+	}
+	return ranges;
+}
+
+// Maps a CSV file and parses it on several threads, one
+// range of whole lines each. Rows have min_fields to
+// field_count fields, missing trailing ones read as
+// empty. parse_row fills the thread's Chunk from a row
+// and returns nullptr, or a reason when the row is bad.
+// Bad rows are reported and skipped. reserve gets the
+// number of good rows, then the chunks are handed to
+// merge in file order on the calling thread. Field
+// views point into the mapping and stay valid until
+// merge returns.
+template <typename Chunk, typename ParseRow, typename Reserve,
+	typename Merge>
+bool ImportCsv(const string& path, size_t min_fields, size_t field_count,
+	bool has_header,
+	size_t threads, ImportStats& stats, string* error,
+	ParseRow parse_row, Reserve reserve, Merge merge)
+{
+	auto start = chrono::steady_clock::now();
+	MappedFile file;
+	if (!file.Open(path)) {
+		// An empty file cannot be mapped, but it is
+		// a valid import of no rows
+		ifstream in(path, ios::binary);
+		if (in && in.peek() == ifstream::traits_type::eof())
+			return true;
+		if (error)
+			*error = path + ": cannot open";
+		return false;
+	}
+
+	string_view data(file.Data(), file.Size());
+	if (threads == 0)
+		threads = max(1u, thread::hardware_concurrency());
+	vector<pair<size_t, size_t>> ranges = SplitLines(data, threads);
+
+	vector<Chunk> chunks(ranges.size());
+	vector<deque<string>> scratch(ranges.size());
+	vector<vector<CsvError>> errors(ranges.size());
+	vector<size_t> lines(ranges.size()), rows(ranges.size());
+
+	vector<thread> workers;
+	for (size_t c = 0; c < ranges.size(); c++) {
+		workers.emplace_back([&, c] {
+			vector<string_view> fields(field_count + 1);
+			size_t pos = ranges[c].first, end = ranges[c].second;
+			size_t line = 0;
+			while (pos < end) {
+				size_t eol = min(data.find('\n', pos), end);
+				string_view text = data.substr(pos, eol - pos);
+				pos = eol + 1;
+				line++;
+
+				if (!text.empty() && text.back() == '\r')
+					text.remove_suffix(1);
+				if (text.empty() || (c == 0 && line == 1 && has_header))
+					continue;
+
+				const char* reason = "wrong number of fields";
+				size_t count = SplitCsvLine(text, fields.data(),
+					field_count, scratch[c]);
+				if (count >= min_fields && count <= field_count) {
+					fill(fields.begin() + count, fields.end(), string_view());
+					reason = parse_row(chunks[c], fields.data());
+				}
+				if (reason)
+					errors[c].push_back({ line, reason });
+				else
+					rows[c]++;
+			}
+			lines[c] = line;
+		});
+	}
+	for (thread& worker : workers)
+		worker.join();
+
+	reserve(accumulate(rows.begin(), rows.end(), size_t(0)));
+	size_t first_line = 1;
+	for (size_t c = 0; c < ranges.size(); c++) {
+		for (CsvError& e : errors[c]) {
+			e.line += first_line - 1;
+			stats.errors.push_back(move(e));
+		}
+		merge(chunks[c]);
+		first_line += lines[c];
+		stats.rows += rows[c];
+	}
+
+	stats.bytes += data.size();
+	stats.seconds += chrono::duration<double>(
+		chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+// Loads hospitals from CSV rows of
+//   name,location,beds,rating,contact,doctor,price[,lat,lon]
+// after a header line. Coordinates are optional. Each
+// thread interns cities and doctors in its own
+// dictionary, so the table's pools are only touched
+// once per distinct value and thread.
+bool ImportHospitalsCsv(const string& path, HospitalTable& hospitals,
+	ImportStats& stats, string* error = nullptr, size_t threads = 0)
+{
+	struct Chunk {
+		struct Row {
+			string_view name, contact;
+			uint32_t city, doctor;
+			int beds;
+			float rating;
+			int price;
+			float latitude, longitude;
+		};
+		vector<Row> rows;
+		StringPool cities, doctors;
+	};
+
+	auto parse_row = [](Chunk& chunk, const string_view* f) -> const char* {
+		Chunk::Row row;
+		if (f[0].empty())
+			return "empty name";
+		if (!ParseNumber(f[2], row.beds) || row.beds < 0)
+			return "bad beds";
+		if (!ParseNumber(f[3], row.rating))
+			return "bad rating";
+		if (!ParseNumber(f[6], row.price) || row.price < 0)
+			return "bad price";
+		row.latitude = row.longitude = NAN;
+		if (!f[7].empty() || !f[8].empty()) {
+			if (!ParseNumber(f[7], row.latitude)
+				|| !ParseNumber(f[8], row.longitude)
+				|| fabs(row.latitude) > 90 || fabs(row.longitude) > 180)
+				return "bad coordinates";
+		}
+		row.name = f[0];
+		row.city = chunk.cities.Intern(f[1]);
+		row.contact = f[4];
+		row.doctor = chunk.doctors.Intern(f[5]);
+		chunk.rows.push_back(row);
+		return nullptr;
+	};
+
+	auto merge = [&](Chunk& chunk) {
+		vector<uint32_t> cities, doctors;
+		for (uint32_t id = 0; id < chunk.cities.Size(); id++)
+			cities.push_back(hospitals.InternCity(chunk.cities.Get(id)));
+		for (uint32_t id = 0; id < chunk.doctors.Size(); id++)
+			doctors.push_back(hospitals.InternDoctor(chunk.doctors.Get(id)));
+		for (const Chunk::Row& row : chunk.rows)
+			hospitals.AddInterned(hospitals.InternName(row.name),
+				cities[row.city], doctors[row.doctor], row.contact,
+				row.beds, row.rating, row.price, row.latitude,
+				row.longitude);
+	};
+
+	auto reserve = [&](size_t rows) { hospitals.Reserve(rows); };
+
+	return ImportCsv<Chunk>(path, 7, 9, true, threads, stats, error,
+		parse_row, reserve, merge);
+}
+
+// Loads waiting patients from CSV rows of
+//   name,id,contact,city,expenditure[,hospital]
+// after a header line. The allotted hospital that
+// ExportData writes last is accepted and ignored:
+// imported patients all start out waiting.
+bool ImportPatientsCsv(const string& path, PatientTable& patients,
+	ImportStats& stats, string* error = nullptr, size_t threads = 0)
+{
+	struct Row {
+		string_view name, contact, city;
+		int id, expenditure;
+	};
+	typedef vector<Row> Chunk;
+
+	auto parse_row = [](Chunk& chunk, const string_view* f) -> const char* {
+		Row row;
+		if (f[0].empty())
+			return "empty name";
+		if (!ParseNumber(f[1], row.id))
+			return "bad id";
+		if (!ParseNumber(f[4], row.expenditure))
+			return "bad expenditure";
+		row.name = f[0];
+		row.contact = f[2];
+		row.city = f[3];
+		chunk.push_back(row);
+		return nullptr;
+	};
+
+	auto merge = [&](Chunk& chunk) {
+		for (const Row& row : chunk)
+			patients.AddPatient(row.name, row.id, row.contact, row.city,
+				row.expenditure);
+	};
+
+	auto reserve = [&](size_t rows) { patients.Reserve(rows); };
+
+	return ImportCsv<Chunk>(path, 5, 6, true, threads, stats, error,
+		parse_row, reserve, merge);
+}
+
+// Function to report an import
+void PrintImportStats(const string& what, const ImportStats& stats)
+{
+	cout << "Imported " << stats.rows << " " << what
+		<< " (" << stats.bytes << " bytes) in "
+		<< stats.seconds << " s, "
+		<< stats.GBps() << " GB/s, "
+		<< stats.errors.size() << " bad rows"
+		<< endl;
+	for (size_t i = 0; i < stats.errors.size() && i < 10; i++)
+		cout << "  line " << stats.errors[i].line << ": "
+			<< stats.errors[i].reason << endl;
+}
+
+// Output formats of TableRenderer
+enum RenderFormat {
+	RENDER_TEXT, // aligned columns, in pages
+	RENDER_CSV,
+	RENDER_JSON // an array of objects
+};
+
+// Writes rows of cells as a text table, CSV or JSON.
+//
+// Numbers are formatted with to_chars and everything
+// goes into one large buffer that is handed to the
+// stream when full, so there is no per-field stream
+// call and no flush per row. Text output is split into
+// pages of page_rows rows (0 for a single page): a page
+// is kept until it is complete, the column widths are
+// taken while its cells arrive, and it is written padded
+// under its own header. CSV and JSON rows are written as
+// they arrive.
+//
+//   TableRenderer out(cout, RENDER_TEXT, 50);
+//   out.Columns({ "Name", "Beds" });
+//   out.Add(name); out.Add(beds); out.EndRow();
+//   out.Finish();
+class TableRenderer {
+public:
+	static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+	explicit TableRenderer(ostream& out, RenderFormat format = RENDER_TEXT,
+		size_t page_rows = 0)
+		: out(out), format(format), page_rows(page_rows)
+	{
+		buffer.reserve(BUFFER_SIZE);
+	}
+
+	TableRenderer(const TableRenderer&) = delete;
+	TableRenderer& operator=(const TableRenderer&) = delete;
+
+	~TableRenderer()
+	{
+		Finish();
+	}
+
+	// Sets the column names, which must outlive the
+	// renderer. Call once, before the first row.
+	void Columns(const vector<string_view>& names)
+	{
+		headers = names;
+		widths.assign(headers.size(), 0);
+		numeric.assign(headers.size(), false);
+		if (format == RENDER_CSV) {
+			for (size_t c = 0; c < headers.size(); c++)
+				CsvField(headers[c], c);
+			buffer += '\n';
+		}
+		else if (format == RENDER_JSON)
+			buffer += '[';
+	}
+
+	void Add(string_view value)
+	{
+		Cell(value, false);
+	}
+
+	void Add(long long value)
+	{
+		char digits[24];
+		auto result = to_chars(digits, digits + sizeof(digits), value);
+		Cell(string_view(digits, result.ptr - digits), true);
+	}
+
+	void Add(int value)
+	{
+		Add((long long)value);
+	}
+
+	void Add(uint32_t value)
+	{
+		Add((long long)value);
+	}
+
+	// Unknown (NaN) and infinite values are left empty,
+	// or null in JSON
+	void Add(float value)
+	{
+		if (!isfinite(value)) {
+			Cell(format == RENDER_JSON ? "null" : "", true);
+			return;
+		}
+		char digits[32];
+		auto result = to_chars(digits, digits + sizeof(digits), value);
+		Cell(string_view(digits, result.ptr - digits), true);
+	}
+
+	void EndRow()
+	{
+		column = 0;
+		rows++;
+		if (format == RENDER_TEXT) {
+			page_ends.push_back(cell_ends.size());
+			if (page_rows != 0 && page_ends.size() == page_rows)
+				WritePage();
+		}
+		else if (format == RENDER_JSON)
+			buffer += '}';
+		else
+			buffer += '\n';
+		if (buffer.size() >= BUFFER_SIZE)
+			Flush();
+	}
+
+	// Writes out what is left. Nothing can be added
+	// afterwards.
+	void Finish()
+	{
+		if (finished)
+			return;
+		finished = true;
+		if (format == RENDER_TEXT)
+			WritePage();
+		else if (format == RENDER_JSON)
+			buffer += rows == 0 ? "]\n" : "\n]\n";
+		Flush();
+	}
+
+	size_t Rows() const
+	{
+		return rows;
+	}
+
+private:
+	ostream& out;
+	RenderFormat format;
+	size_t page_rows;
+	string buffer;
+	vector<string_view> headers;
+	size_t column = 0;
+	size_t rows = 0;
+	size_t pages = 0;
+	bool finished = false;
+
+	// The text page being collected: cell bytes, the end
+	// of each cell and the cell count at the end of each
+	// row
+	string cells;
+	vector<size_t> cell_ends;
+	vector<size_t> page_ends;
+	vector<size_t> widths;
+	vector<bool> numeric; // numbers are right aligned
+
+	void Cell(string_view value, bool number)
+	{
+		switch (format) {
+		case RENDER_TEXT:
+			cells.append(value);
+			cell_ends.push_back(cells.size());
+			if (column < widths.size()) {
+				widths[column] = max(widths[column], value.size());
+				numeric[column] = number;
+			}
+			break;
+		case RENDER_CSV:
+			CsvField(value, column);
+			break;
+		case RENDER_JSON:
+			buffer += column == 0 ? (rows == 0 ? "\n{" : ",\n{") : ",";
+			JsonString(column < headers.size() ? headers[column] : "");
+			buffer += ':';
+			if (number)
+				buffer.append(value);
+			else
+				JsonString(value);
+			break;
+		}
+		column++;
+	}
+
+	void CsvField(string_view value, size_t index)
+	{
+		if (index != 0)
+			buffer += ',';
+		if (value.find_first_of(",\"\r\n") == string_view::npos) {
+			buffer.append(value);
+			return;
+		}
+		buffer += '"';
+		for (char c : value) {
+			if (c == '"')
+				buffer += '"';
+			buffer += c;
+		}
+		buffer += '"';
+	}
+
+	void JsonString(string_view value)
+	{
+		buffer += '"';
+		for (char c : value) {
+			if (c == '"' || c == '\\') {
+				buffer += '\\';
+				buffer += c;
+			}
+			else if ((unsigned char)c < 0x20) {
+				char escape[8];
+				snprintf(escape, sizeof(escape), "\\u%04x", c);
+				buffer += escape;
+			}
+			else
+				buffer += c;
+		}
+		buffer += '"';
+	}
+
+	void Pad(string_view value, size_t width, bool right, bool last)
+	{
+		if (right)
+			buffer.append(width - value.size(), ' ');
+		buffer.append(value);
+		if (!right && !last)
+			buffer.append(width - value.size(), ' ');
+		if (!last)
+			buffer.append(2, ' ');
+	}
+
+	void WritePage()
+	{
+		if (page_ends.empty() && pages != 0)
+			return;
+		if (pages++ != 0)
+			buffer += '\n';
+
+		for (size_t c = 0; c < headers.size(); c++)
+			widths[c] = max(widths[c], headers[c].size());
+		for (size_t c = 0; c < headers.size(); c++)
+			Pad(headers[c], widths[c], numeric[c], c + 1 == headers.size());
+		buffer += '\n';
+
+		size_t cell = 0, start = 0;
+		for (size_t end : page_ends) {
+			for (size_t c = 0; cell < end; c++, cell++) {
+				string_view value(cells.data() + start, cell_ends[cell] - start);
+				start = cell_ends[cell];
+				bool last = cell + 1 == end;
+				if (c < widths.size())
+					Pad(value, widths[c], numeric[c], last);
+				else
+					buffer.append(value);
+			}
+			buffer += '\n';
+			if (buffer.size() >= BUFFER_SIZE)
+				Flush();
+		}
+
+		cells.clear();
+		cell_ends.clear();
+		page_ends.clear();
+		fill(widths.begin(), widths.end(), 0);
+	}
+
+	void Flush()
+	{
+		out.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+};
+
+// Rows per page of the printed tables 
+const size_t PRINT_PAGE_ROWS = 1000; 
+
+const vector<string_view> HOSPITAL_COLUMN_NAMES = { 
+	"HospitalName", "Location", "Beds_Available", "Rating", 
+	"Hospital_Contact", "Doctor_Name", "Price_Per_Bed", "Latitude", 
+	"Longitude"
 }; 
 
-// Hospital Data 
-void PrintHospitalData( 
-	vector<Hospital>& hospitals) 
-{ 
-	cout << "PRINT hospitals DATA:"
-		<< endl; 
+// Columns of the printed tables 
+const vector<HospitalColumn> PRINT_HOSPITAL_COLUMNS = { 
+	COL_NAME, COL_CITY, COL_BEDS, COL_RATING, COL_CONTACT, COL_DOCTOR, 
+	COL_PRICE 
+}; 
 
-	cout << "HospitalName	 "
-		<< "Location	 "
-		<< "Beds_Available	 "
-		<< "Rating	 "
-		<< "Hospital_Contact	 "
-		<< "Doctor_Name	 "
-		<< "Price_Per_Bed	 \n"; 
-
-	for (int i = 0; i < 4; i++) { 
-		cout << hospitals[i].H_name 
-			<< "				 "
-			<< "	 "
-			<< hospitals[i].location 
-			<< "		 "
-			<< hospitals[i].available_beds 
-			<< "				 "
-			<< hospitals[i].rating 
-			<< "		 "
-			<< hospitals[i].contact 
-			<< "			 "
-			<< hospitals[i].doctor_name 
-			<< "				 "
-			<< "	 "
-			<< hospitals[i].price 
-			<< "		 "
-			<< endl; 
-	} 
+// Columns of an export, in the order 
+// ImportHospitalsCsv reads them back 
+const vector<HospitalColumn> EXPORT_HOSPITAL_COLUMNS = { 
+	COL_NAME, COL_CITY, COL_BEDS, COL_RATING, COL_CONTACT, COL_DOCTOR, 
+	COL_PRICE, COL_LATITUDE, COL_LONGITUDE 
+}; 
 
-	cout << endl 
-		<< endl; 
+// Function to start a hospital table 
+// with the given columns 
+void AddHospitalColumns(TableRenderer& out, 
+	const vector<HospitalColumn>& columns) 
+{ 
+	vector<string_view> names; 
+	for (HospitalColumn column : columns) 
+		names.push_back(HOSPITAL_COLUMN_NAMES[column]); 
+	out.Columns(names); 
 } 
 
-// Function to print the patient 
-// data in the hospital 
-void PrintPatientData( 
-	vector<Patient>& patients, 
-	vector<Hospital>& hospitals) 
+// Function to add one hospital 
+// as a row 
+void AddHospitalRow(TableRenderer& out, const HospitalTable& hospitals, 
+	uint32_t i, const vector<HospitalColumn>& columns) 
 { 
-	cout << "PRINT patients DATA:"
-		<< endl; 
-	cout << "Patient_Name	 "
-		<< "Patient_Id	 "
-		<< "Patient_Contact	 "
-		<< "Alloted_Hospital	 "
-		<< "Patient_Expenditure	 \n"; 
-
-	for (int i = 0; i < 4; i++) { 
-		cout << patients[i].P_name 
-			<< "			 "
-			<< "		 "
-			<< patients[i].P_id 
-			<< "			 "
-			<< "		 "
-			<< patients[i].contact 
-			<< "				 "
-			<< hospitals[i].H_name 
-			<< "				 "
-			<< patients[i].price 
-			<< "		 "
-			<< endl; 
+	for (HospitalColumn column : columns) { 
+		switch (column) { 
+		case COL_NAME: out.Add(hospitals.Name(i)); break; 
+		case COL_CITY: out.Add(hospitals.Location(i)); break; 
+		case COL_BEDS: out.Add(hospitals.Beds()[i]); break; 
+		case COL_RATING: out.Add(hospitals.Ratings()[i]); break; 
+		case COL_CONTACT: out.Add(hospitals.Contact(i)); break; 
+		case COL_DOCTOR: out.Add(hospitals.Doctor(i)); break; 
+		case COL_PRICE: out.Add(hospitals.Prices()[i]); break; 
+		case COL_LATITUDE: out.Add(hospitals.Latitudes()[i]); break; 
+		default: out.Add(hospitals.Longitudes()[i]); break; 
+		} 
 	} 
+	out.EndRow(); 
+} 
 
-	cout << endl 
-		<< endl; 
+// Function to write the given rows 
+// of the table, in the given order 
+void RenderHospitalRows(const HospitalTable& hospitals, 
+	const vector<uint32_t>& rows, ostream& os = cout, 
+	RenderFormat format = RENDER_TEXT, 
+	const vector<HospitalColumn>& columns = PRINT_HOSPITAL_COLUMNS) 
+{ 
+	TableRenderer out(os, format, PRINT_PAGE_ROWS); 
+	AddHospitalColumns(out, columns); 
+	for (uint32_t i : rows) 
+		AddHospitalRow(out, hospitals, i, columns); 
 } 
 
-// Comparator function to sort the 
-// hospital data by name 
-bool name(Hospital& A, Hospital& B) 
+// Function to print the given rows 
+// of the table, in the given order 
+void PrintHospitalRows(const HospitalTable& hospitals, 
+	const vector<uint32_t>& rows) 
 { 
-	return A.H_name > B.H_name; 
+	cout << "PRINT hospitals DATA:\n"; 
+	RenderHospitalRows(hospitals, rows); 
 } 
 
-// Function to sort the hospital 
-// data by name 
-void SortHospitalByName( 
-	vector<Hospital> hospitals) 
+// Function to print the hospital 
+// data straight from the table 
+void PrintHospitalData(const HospitalTable& hospitals) 
 { 
-	// Sort the date 
-	sort(hospitals.begin(), 
-		hospitals.end(), 
-		name); 
+	cout << "PRINT hospitals DATA:\n"; 
+	TableRenderer out(cout, RENDER_TEXT, PRINT_PAGE_ROWS); 
+	AddHospitalColumns(out, PRINT_HOSPITAL_COLUMNS); 
+	for (uint32_t i = 0; i < hospitals.Size(); i++) 
+		AddHospitalRow(out, hospitals, i, PRINT_HOSPITAL_COLUMNS); 
+	out.Finish(); 
 
-	cout << "SORT BY NAME:"
-		<< endl 
-		<< endl; 
-	PrintHospitalData(hospitals); 
+	cout << "Total free beds: "
+		<< hospitals.TotalFreeBeds() 
+		<< " across "
+		<< hospitals.FilterByBeds(1).size() 
+		<< " hospitals with space"
+		<< "\n\n\n"; 
 } 
 
-// Comparator function to sort the 
-// hospital data by rating 
-bool rating(Hospital& A, Hospital& B) 
+// Function to write the patient 
+// data in the hospital. With import_order 
+// the allotted hospital comes last, in the 
+// column order ImportPatientsCsv reads. 
+void RenderPatientData( 
+	const PatientTable& patients, 
+	const HospitalTable& hospitals, 
+	ostream& os = cout, RenderFormat format = RENDER_TEXT, 
+	bool import_order = false) 
 { 
-	return A.rating > B.rating; 
+	TableRenderer out(os, format, PRINT_PAGE_ROWS); 
+	if (import_order) 
+		out.Columns({ "Patient_Name", "Patient_Id", "Patient_Contact", 
+			"Patient_City", "Patient_Expenditure", "Alloted_Hospital" }); 
+	else 
+		out.Columns({ "Patient_Name", "Patient_Id", "Patient_Contact", 
+			"Patient_City", "Alloted_Hospital", "Patient_Expenditure" }); 
+
+	for (uint32_t i = 0; i < patients.Size(); i++) { 
+		uint32_t hospital = patients.HospitalOf(i); 
+		string_view allotted = hospital != PatientTable::npos 
+			? hospitals.Name(hospital) 
+			: string_view("None"); 
+		out.Add(patients.Name(i)); 
+		out.Add(patients.Id(i)); 
+		out.Add(patients.Contact(i)); 
+		out.Add(patients.City(i)); 
+		if (!import_order) 
+			out.Add(allotted); 
+		out.Add(patients.Expenditure(i)); 
+		if (import_order) 
+			out.Add(allotted); 
+		out.EndRow(); 
+	} 
 } 
 
-// Function to sort the hospital 
-// data by namerating 
-void SortHospitalByRating(vector<Hospital> hospitals) 
+// Function to print the patient 
+// data in the hospital 
+void PrintPatientData( 
+	const PatientTable& patients, 
+	const HospitalTable& hospitals) 
 { 
-	sort(hospitals.begin(), 
-		hospitals.end(), 
-		rating); 
+	cout << "PRINT patients DATA:\n"; 
+	RenderPatientData(patients, hospitals); 
+	cout << "\n\n"; 
+} 
 
-	cout << "SORT BY Rating:"
+// Function to print the hospital 
+// data by name. The listing walks the 
+// table's sorted view instead of sorting 
+// a copy of every hospital. 
+void SortHospitalByName(const HospitalTable& hospitals) 
+{ 
+	cout << "SORT BY NAME:"
 		<< endl 
 		<< endl; 
-
-	PrintHospitalData(hospitals); 
+	PrintHospitalRows(hospitals, hospitals.SortedBy(BY_NAME)); 
+	cout << endl 
+		<< endl; 
 } 
 
-// Comparator function to sort the 
-// hospital data by Bed Available 
-bool beds(Hospital& A, Hospital& B) 
+// Function to print the hospital 
+// data by rating 
+void SortHospitalByRating(const HospitalTable& hospitals) 
 { 
-	return A.available_beds > B.available_beds; 
+	cout << "SORT BY Rating:"
+		<< endl 
+		<< endl; 
+	PrintHospitalRows(hospitals, hospitals.SortedBy(BY_RATING)); 
+	cout << endl 
+		<< endl; 
 } 
 
-// Function to sort the hospital 
+// Function to print the hospital 
 // data by Bed Available 
-void SortByBedsAvailable( 
-	vector<Hospital> hospitals) 
+void SortByBedsAvailable(const HospitalTable& hospitals) 
 { 
-	sort(hospitals.begin(), 
-		hospitals.end(), 
-		beds); 
-
 	cout << "SORT BY Available Beds:"
 		<< endl 
 		<< endl; 
-
-	PrintHospitalData(hospitals); 
-} 
-
-// Comparator function to sort the 
-// hospital data by Bed Price 
-bool beds_price(Hospital& A, Hospital& B) 
-{ 
-	return A.price < B.price; 
+	PrintHospitalRows(hospitals, hospitals.SortedBy(BY_BEDS)); 
+	cout << endl 
+		<< endl; 
 } 
 
-// Function to sort the hospital 
+// Function to print the hospital 
 // data by Bed Price 
-void SortByBedsPrice( 
-	vector<Hospital> hospitals) 
+void SortByBedsPrice(const HospitalTable& hospitals) 
 { 
-	sort(hospitals.begin(), 
-		hospitals.end(), 
-		beds_price); 
-
 	cout << "SORT BY Available Beds Price:"
 		<< endl 
 		<< endl; 
-
-	PrintHospitalData(hospitals); 
+	PrintHospitalRows(hospitals, hospitals.SortedBy(BY_PRICE)); 
+	cout << endl 
+		<< endl; 
 } 
 
-// Comparator function to sort the 
-// hospital data by City 
+// Function to print the hospital 
+// data of one city, using the city index 
 void PrintHospitalBycity( 
-	string city, vector<Hospital> hospitals) 
+	const string& city, const HospitalTable& hospitals) 
 { 
 	cout << "PRINT hospitals by Name :"
-		<< city << endl; 
+		<< city << "\n"; 
+	RenderHospitalRows(hospitals, hospitals.RowsInCity(city)); 
+	cout << "\n\n"; 
+} 
 
-	cout << "HospitalName	 "
-		<< "Location	 "
-		<< "Beds_Available	 "
-		<< "Rating	 "
-		<< "Hospital_Contact	 "
-		<< "Doctor_Name	 "
-		<< "Price_Per_Bed	 \n"; 
+// Function to print a query's rows 
+// as they stream out, projected 
+// columns only 
+void PrintQuery(const HospitalQuery& query, 
+	const HospitalTable& hospitals, ostream& os = cout, 
+	RenderFormat format = RENDER_TEXT) 
+{ 
+	TableRenderer out(os, format, PRINT_PAGE_ROWS); 
+	AddHospitalColumns(out, query.Columns()); 
+	query.ForEach([&](uint32_t i) { 
+		AddHospitalRow(out, hospitals, i, query.Columns()); 
+	}); 
+} 
 
-	for (int i = 0; i < 4; i++) { 
+// Function to export the hospitals or 
+// the patients to a file, as JSON when 
+// the name ends in .json, else as CSV. 
+// Columns follow the CSV importers, so 
+// an exported file loads back. 
+bool ExportData(const string& path, const HospitalTable& hospitals, 
+	const PatientTable* patients, string* error = nullptr) 
+{ 
+	ofstream file(path, ios::binary); 
+	RenderFormat format 
+		= path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0 
+		? RENDER_JSON 
+		: RENDER_CSV; 
+	if (patients) 
+		RenderPatientData(*patients, hospitals, file, format, true); 
+	else { 
+		vector<uint32_t> rows(hospitals.Size()); 
+		iota(rows.begin(), rows.end(), 0); 
+		RenderHospitalRows(hospitals, rows, file, format, 
+			EXPORT_HOSPITAL_COLUMNS); 
+	} 
+	file.close(); 
+	if (!file) { 
+		if (error) 
+			*error = path + ": cannot write"; 
+		return false; 
+	} 
+	return true; 
+} 
 
-		if (hospitals[i].location != city) 
-			continue; 
-		cout << hospitals[i].H_name 
-			<< "				 "
-			<< "	 "
-			<< hospitals[i].location 
-			<< "		 "
-			<< hospitals[i].available_beds 
-			<< "				 "
-			<< hospitals[i].rating 
-			<< "		 "
-			<< hospitals[i].contact 
-			<< "			 "
-			<< hospitals[i].doctor_name 
-			<< "			 "
-			<< "		 "
-			<< hospitals[i].price 
-			<< "		 "
-			<< endl; 
+// Function to print the running 
+// totals of one city 
+void PrintCityStats(const string& city, 
+	const HospitalTable& hospitals, const OccupancyStats& stats) 
+{ 
+	uint32_t id = hospitals.FindCity(city); 
+	if (id == StringPool::npos || id >= stats.CityCount()) { 
+		cout << "No hospitals in " << city << endl; 
+		return; 
 	} 
-	cout << endl 
+	cout << "CITY " << city << ": "
+		<< stats.CityHospitals(id) << " hospitals, "
+		<< stats.CityFreeBeds(id) << " free beds, "
+		<< "average rating " << stats.CityAverageRating(id) 
+		<< ", price from " << stats.CityMinPrice(id) 
+		<< ", median " << stats.CityMedianPrice(id) 
 		<< endl; 
 } 
 
-// Function to implement Hospital 
-// Management System 
-void HospitalManagement( 
+// Function to fill the tables 
+// from the sample arrays 
+void BuildSampleData( 
 	string patient_Name[], int patient_Id[], 
 	string patient_Contact[], int bookingCost[], 
 	string hospital_Name[], string locations[], int beds[], 
 	float ratings[], string hospital_Contact[], 
-	string doctor_Name[], int prices[]) 
+	string doctor_Name[], int prices[], 
+	float latitudes[], float longitudes[], size_t hospital_count, 
+	size_t patient_count, HospitalTable& hospitals, PatientTable& patients) 
 { 
-	// Stores the Hospital data 
-	// and user data 
-	vector<Hospital> hospitals; 
-
 	// Create Objects for hospital 
 	// and the users 
 	Hospital h; 
 
 	// Initialize the data 
-	for (int i = 0; i < 4; i++) { 
+	for (size_t i = 0; i < hospital_count; i++) { 
 		h.H_name = hospital_Name[i]; 
 		h.location = locations[i]; 
 		h.available_beds = beds[i]; 
@@ -254,20 +3595,129 @@ void HospitalManagement(
 		h.contact = hospital_Contact[i]; 
 		h.doctor_name = doctor_Name[i]; 
 		h.price = prices[i]; 
-		hospitals.push_back(h); 
+		h.latitude = latitudes[i]; 
+		h.longitude = longitudes[i]; 
+		hospitals.AddHospital(h); 
 	} 
 
-	// Stores the patient data 
-	vector<Patient> patients; 
-	Patient p; 
+	// Initialize the patient data 
+	for (size_t i = 0; i < patient_count; i++) 
+		patients.AddPatient(patient_Name[i], patient_Id[i], 
+			patient_Contact[i], "", bookingCost[i]); 
+} 
 
-	// Initialize the data 
-	for (int i = 0; i < 4; i++) { 
-		p.P_name = patient_Name[i]; 
-		p.P_id = patient_Id[i]; 
-		p.contact = patient_Contact[i]; 
-		p.price = bookingCost[i]; 
-		patients.push_back(p); 
+// Function to log an event when there is 
+// a log and then apply it to the tables 
+bool LogAndApply(WalEventType type, uint32_t a, int32_t b, 
+	HospitalTable& hospitals, PatientTable& patients, 
+	WriteAheadLog* log) 
+{ 
+	WalRecord r = WalRecord(); 
+	r.type = type; 
+	r.a = a; 
+	r.b = b; 
+	if (log && !log->Append(type, a, b)) 
+		return false; 
+	return ApplyWalRecord(r, hospitals, patients); 
+} 
+
+// Function to discharge the patient with 
+// the given id 
+void DischargePatient(int id, HospitalTable& hospitals, 
+	PatientTable& patients, WriteAheadLog* log = nullptr) 
+{ 
+	for (uint32_t i = 0; i < patients.Size(); i++) { 
+		if (patients.Id(i) != id) 
+			continue; 
+		if (patients.HospitalOf(i) == PatientTable::npos) 
+			cout << "Patient " << id << " is not admitted" << endl; 
+		else if (!LogAndApply(WAL_DISCHARGE, i, 0, 
+					 hospitals, patients, log)) 
+			cout << "Could not log discharge of " << id << endl; 
+		return; 
+	} 
+	cout << "No patient " << id << endl; 
+} 
+
+// Function to set the free beds of the 
+// hospital with the given name 
+void SetHospitalBeds(const string& name, int beds, 
+	HospitalTable& hospitals, PatientTable& patients, 
+	WriteAheadLog* log = nullptr) 
+{ 
+	for (uint32_t i = 0; i < hospitals.Size(); i++) { 
+		if (hospitals.Name(i) != name) 
+			continue; 
+		if (!LogAndApply(WAL_SET_BEDS, i, beds, 
+				hospitals, patients, log)) 
+			cout << "Could not log beds of " << name << endl; 
+		return; 
+	} 
+	cout << "No hospital " << name << endl; 
+} 
+
+// Function to implement Hospital 
+// Management System 
+void HospitalManagement(HospitalTable& hospitals, 
+	PatientTable& patients, WriteAheadLog* log = nullptr) 
+{ 
+	// Find the cheapest overall allotment 
+	// for the waiting patients, then book 
+	// those beds 
+	vector<uint32_t> waiting, patient_cities; 
+	for (uint32_t i = 0; i < patients.Size(); i++) { 
+		if (patients.HospitalOf(i) != PatientTable::npos) 
+			continue; 
+		waiting.push_back(i); 
+		patient_cities.push_back(hospitals.FindCity(patients.City(i))); 
+	} 
+	vector<uint32_t> chosen 
+		= PatientAssigner(hospitals).Assign(patient_cities); 
+
+	OccupancyStats stats(hospitals); 
+	BedBookingEngine booking(hospitals, &stats); 
+
+	// Admissions run on several threads. Each 
+	// waits for its record to reach the disk, 
+	// and the log syncs the records of all 
+	// waiting threads together 
+	enum { ADMITTED, NO_BED, NOT_LOGGED }; 
+	vector<int> outcome(waiting.size(), ADMITTED); 
+	size_t threads = min<size_t>(waiting.size(), 8); 
+	vector<thread> workers; 
+	for (size_t t = 0; t < threads; t++) { 
+		workers.emplace_back([&, t] { 
+			for (size_t w = t; w < waiting.size(); w += threads) { 
+				if (chosen[w] == PatientAssigner::npos 
+					|| !booking.Reserve(chosen[w])) { 
+					outcome[w] = NO_BED; 
+					continue; 
+				} 
+
+				// The admission is on disk before 
+				// it is applied 
+				if (log && !log->Append(WAL_ADMIT, waiting[w], chosen[w])) { 
+					booking.Release(chosen[w]); 
+					outcome[w] = NOT_LOGGED; 
+					continue; 
+				} 
+				patients.SetHospital(waiting[w], chosen[w]); 
+			} 
+		}); 
+	} 
+	for (thread& worker : workers) 
+		worker.join(); 
+	booking.Commit(hospitals); 
+
+	for (size_t w = 0; w < waiting.size(); w++) { 
+		if (outcome[w] == NO_BED) 
+			cout << "No free bed for "
+				<< patients.Name(waiting[w]) 
+				<< endl; 
+		else if (outcome[w] == NOT_LOGGED) 
+			cout << "Could not log admission of "
+				<< patients.Name(waiting[w]) 
+				<< endl; 
 	} 
 
 	cout << endl; 
@@ -281,10 +3731,48 @@ void HospitalManagement(
 	PrintHospitalBycity("Bangalore", hospitals); 
 	SortByBedsAvailable(hospitals); 
 	SortByBedsPrice(hospitals); 
+
+	cout << "TOP 2 BY Rating:"
+		<< endl 
+		<< endl; 
+	PrintHospitalRows(hospitals, hospitals.TopK(BY_RATING, 2)); 
+
+	cout << endl 
+		<< "PRICE BETWEEN 100 AND 200:"
+		<< endl 
+		<< endl; 
+	PrintHospitalRows(hospitals, hospitals.PriceBetween(100, 200)); 
+
+	cout << endl 
+		<< "NEAREST 2 WITH FREE BEDS TO 12.95, 77.60:"
+		<< endl 
+		<< endl; 
+	vector<uint32_t> nearest; 
+	for (auto& hit : HospitalLocator(hospitals).Nearest(12.95, 77.60, 2)) 
+		nearest.push_back(hit.first); 
+	PrintHospitalRows(hospitals, nearest); 
+
+	cout << endl 
+		<< "BANGALORE WITH FREE BEDS, CHEAPEST FIRST:"
+		<< endl 
+		<< endl; 
+	PrintQuery(HospitalQuery(hospitals) 
+				   .InCity("Bangalore") 
+				   .MinBeds(1) 
+				   .OrderBy(BY_PRICE) 
+				   .Limit(10) 
+				   .Project({ COL_NAME, COL_BEDS, COL_PRICE }), 
+		hospitals); 
+
+	cout << endl; 
+	PrintCityStats("Bangalore", hospitals, stats); 
+	PrintCityStats("Mumbai", hospitals, stats); 
 } 
 
 // Driver Code 
-int main() 
+// hmt_bench.cpp includes this file with HMT_NO_MAIN defined. 
+#ifndef HMT_NO_MAIN
+int main(int argc, char* argv[]) 
 { 
 	// Stores hospital data and 
 	// the user data 
@@ -305,12 +3793,184 @@ int main()
 			"343456XXX4" }; 
 	string doctor_Name[] = { "D1", "D4", "D3", "D2" }; 
 	int prices[] = { 100, 200, 100, 290 }; 
+	float latitudes[] = { 12.97, 12.93, 19.08, 25.44 }; 
+	float longitudes[] = { 77.59, 77.62, 72.88, 81.85 }; 
+
+	HospitalTable hospitals; 
+	PatientTable patients; 
+
+	// hmt [file] [--hospitals csv] [--patients csv] 
+	//     [--discharge id] [--set-beds name=beds] 
+	//     [--export-hospitals out] [--export-patients out] 
+	// A data file is loaded when it exists and 
+	// saved back at the end. CSV files replace 
+	// the hospitals or patients. Discharges and 
+	// bed counts are applied before admitting. 
+	// Exports are written at the end, as JSON 
+	// for a .json name and CSV otherwise. 
+	string data_file, hospitals_csv, patients_csv; 
+	string hospitals_out, patients_out; 
+	vector<int> discharges; 
+	vector<pair<string, int>> bed_counts; 
+	for (int i = 1; i < argc; i++) { 
+		string arg = argv[i]; 
+		string value = i + 1 < argc ? argv[i + 1] : ""; 
+		size_t equals = value.rfind('='); 
+		int number; 
+		if (arg == "--hospitals" && i + 1 < argc) 
+			hospitals_csv = argv[++i]; 
+		else if (arg == "--patients" && i + 1 < argc) 
+			patients_csv = argv[++i]; 
+		else if (arg == "--export-hospitals" && i + 1 < argc) 
+			hospitals_out = argv[++i]; 
+		else if (arg == "--export-patients" && i + 1 < argc) 
+			patients_out = argv[++i]; 
+		else if (arg == "--discharge" && ParseNumber(value, number)) { 
+			discharges.push_back(number); 
+			i++; 
+		} 
+		else if (arg == "--set-beds" && equals != string::npos 
+			&& ParseNumber(string_view(value).substr(equals + 1), number) 
+			&& number >= 0) { 
+			bed_counts.emplace_back(value.substr(0, equals), number); 
+			i++; 
+		} 
+		else if (arg.compare(0, 2, "--") != 0 && data_file.empty()) 
+			data_file = arg; 
+		else { 
+			// A mistyped option must not become 
+			// the data file that is saved over 
+			cerr << "usage: " << argv[0] 
+				<< " [file] [--hospitals csv] [--patients csv]"
+				<< " [--discharge id] [--set-beds name=beds]"
+				<< " [--export-hospitals out] [--export-patients out]"
+				<< endl; 
+			return 1; 
+		} 
+	} 
+
+	HospitalStore store; 
+	WriteAheadLog log; 
+	uint64_t checkpoint = 0, generation = 0; 
+	string error; 
+	if (!data_file.empty() && ifstream(data_file).good()) { 
+		// Never fall back to the sample data and then 
+		// save over a file that could not be read 
+		if (!store.Open(data_file, &error)) { 
+			cerr << error << endl; 
+			return 1; 
+		} 
+		hospitals = store.LoadTable(); 
+		patients = store.LoadPatients(); 
+		checkpoint = store.CheckpointSeq(); 
+		generation = store.Generation(); 
+		store.Close(); 
+	} 
+	else { 
+		BuildSampleData( 
+			patient_Name, patient_Id, patient_Contact, 
+			bookingCost, hospital_Name, locations, beds, 
+			ratings, hospital_Contact, doctor_Name, prices, 
+			latitudes, longitudes, size(hospital_Name), 
+			size(patient_Name), hospitals, patients); 
+
+		// Home cities for the demo patients, so 
+		// the assignment has distances to weigh 
+		string demo_cities[] = { "Bangalore", "Mumbai", 
+								"Prayagraj", "Bangalore" }; 
+		for (uint32_t i = 0; i < patients.Size(); i++) 
+			patients.SetCity(i, demo_cities[i]); 
+	} 
+
+	// Changes since the last snapshot are 
+	// replayed from the log next to the data 
+	// file. Only a data file that was loaded 
+	// has a log; any other is stale. 
+	string log_file = data_file + ".wal"; 
+	uint64_t last_seq = checkpoint; 
+	if (generation != 0) { 
+		auto apply = [&](const WalRecord& r) { 
+			return ApplyWalRecord(r, hospitals, patients); 
+		}; 
+		if (!WriteAheadLog::Replay(log_file, generation, checkpoint, 
+				apply, last_seq, &error)) { 
+			cerr << error << endl; 
+			return 1; 
+		} 
+	} 
+	if (!data_file.empty() 
+		&& !log.Open(log_file, generation, last_seq, &error)) { 
+		cerr << error << endl; 
+		return 1; 
+	} 
+
+	if (!hospitals_csv.empty()) { 
+		ImportStats stats; 
+		hospitals = HospitalTable(); 
+		if (!ImportHospitalsCsv(hospitals_csv, hospitals, stats, &error)) { 
+			cerr << error << endl; 
+			return 1; 
+		} 
+		PrintImportStats("hospitals", stats); 
+
+		// Allotments point at the old rows 
+		patients.ClearHospitals(); 
+	} 
+	if (!patients_csv.empty()) { 
+		ImportStats stats; 
+		patients = PatientTable(); 
+		if (!ImportPatientsCsv(patients_csv, patients, stats, &error)) { 
+			cerr << error << endl; 
+			return 1; 
+		} 
+		PrintImportStats("patients", stats); 
+	} 
+
+	// Saves a snapshot holding every logged 
+	// event, then starts an empty log of a new 
+	// generation. A crash in between leaves a 
+	// log the snapshot no longer replays. 
+	auto checkpoint_data = [&]() { 
+		uint64_t next = NewWalGeneration(); 
+		if (!HospitalStore::Save(data_file, hospitals, patients, 
+				&error, log.LastSeq(), next) 
+			|| !log.Reset(next)) { 
+			cerr << error << endl; 
+			return false; 
+		} 
+		return true; 
+	}; 
+
+	// Logged rows must refer to tables that 
+	// are on disk, not to sample data or to 
+	// tables that were just replaced 
+	if (!data_file.empty() 
+		&& (generation == 0 || !hospitals_csv.empty() 
+			|| !patients_csv.empty()) 
+		&& !checkpoint_data()) 
+		return 1; 
+
+	WriteAheadLog* wal = data_file.empty() ? nullptr : &log; 
+	for (int id : discharges) 
+		DischargePatient(id, hospitals, patients, wal); 
+	for (auto& change : bed_counts) 
+		SetHospitalBeds(change.first, change.second, 
+			hospitals, patients, wal); 
 
 	// Function Call 
-	HospitalManagement( 
-		patient_Name, patient_Id, patient_Contact, 
-		bookingCost, hospital_Name, locations, beds, 
-		ratings, hospital_Contact, doctor_Name, prices); 
+	HospitalManagement(hospitals, patients, wal); 
+
+	if (!data_file.empty() && !checkpoint_data()) 
+		return 1; 
+
+	if ((!hospitals_out.empty() 
+			&& !ExportData(hospitals_out, hospitals, nullptr, &error)) 
+		|| (!patients_out.empty() 
+			&& !ExportData(patients_out, hospitals, &patients, &error))) { 
+		cerr << error << endl; 
+		return 1; 
+	} 
 
 	return 0; 
-}
+} 
+#endif
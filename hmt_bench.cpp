@@ -0,0 +1,641 @@
+// Hospital Management System benchmark
+//
+// Stress tests the BedBookingEngine: admission threads
+// reserve and release beds at random hospitals at the
+// same time, and the harness reports bookings per second
+// for 1, 2, 4 ... threads. After every run it checks that
+// no hospital was overbooked, that every bed is
+// accounted for and that the per-city totals match.
+// It then measures the write-ahead log: durable
+// admissions per second and how many of them shared
+// each fsync.
+//
+// Last comes the workload suite, the baseline for data
+// layout changes. At 1k, 1M and 10M records it generates
+// hospitals and patients over Zipf-distributed cities,
+// then times CSV loads, the data file, sorts, city
+// lookups, top-k queries and concurrent admissions, and
+// reports the memory each record costs.
+//
+// Build and run:
+//   g++ -std=c++17 -O2 -pthread -o hmt_bench hmt_bench.cpp
+//   ./hmt_bench
+//   ./hmt_bench --threads 16 --hospitals 100000 --ops 2000000
+//   ./hmt_bench --wal-events 10000
+//   ./hmt_bench --sizes 1000,100000
+
+#define HMT_NO_MAIN
+#include "hmt.cpp"
+
+// Live heap bytes, kept by the operator new and delete
+// replacements below so the workload can report what
+// each record costs. Resident memory would also count
+// the mapped CSV files and can shrink between samples.
+static atomic<long long> heap_bytes(0);
+
+// Every block starts with its size, so delete knows how
+// much to take off. The header keeps malloc's alignment.
+const size_t BLOCK_HEADER = alignof(max_align_t);
+
+// GCC inlines the replacements and then reports malloc
+// and free as mismatched with new and delete
+#ifdef __GNUC__
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE void* operator new(size_t size)
+{
+	char* block = (char*)malloc(size + BLOCK_HEADER);
+	if (block == nullptr)
+		throw bad_alloc();
+	memcpy(block, &size, sizeof(size));
+	heap_bytes.fetch_add(size, memory_order_relaxed);
+	return block + BLOCK_HEADER;
+}
+
+BENCH_NOINLINE void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+BENCH_NOINLINE void operator delete(void* p) noexcept
+{
+	if (p == nullptr)
+		return;
+	char* block = (char*)p - BLOCK_HEADER;
+	size_t size;
+	memcpy(&size, block, sizeof(size));
+	heap_bytes.fetch_sub(size, memory_order_relaxed);
+	free(block);
+}
+
+BENCH_NOINLINE void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+BENCH_NOINLINE void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+BENCH_NOINLINE void operator delete[](void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+// Builds a table of synthetic hospitals with the
+// same number of free beds each
+HospitalTable MakeHospitals(size_t count, int beds)
+{
+	HospitalTable hospitals;
+	Hospital h;
+	for (size_t i = 0; i < count; i++) {
+		h.H_name = "H" + to_string(i);
+		h.location = "City" + to_string(i % 100);
+		h.available_beds = beds;
+		h.rating = (i % 50) / 10.0f;
+		h.contact = "000000XXX0";
+		h.doctor_name = "D" + to_string(i % 1000);
+		h.price = 100 + i % 400;
+		hospitals.AddHospital(h);
+	}
+	return hospitals;
+}
+
+// Random admissions and discharges. Each thread keeps
+// the beds it holds and releases one of them about a
+// third of the time, so the counters keep moving both
+// ways and contention stays realistic.
+void BenchBookings(HospitalTable& hospitals,
+	int threads, size_t ops)
+{
+	OccupancyStats stats(hospitals);
+	BedBookingEngine booking(hospitals, &stats);
+	vector<vector<uint32_t>> held(threads);
+	vector<size_t> booked(threads);
+
+	auto start = chrono::steady_clock::now();
+	vector<thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			mt19937 rng(t + 1);
+			vector<uint32_t>& mine = held[t];
+			size_t count = 0;
+			for (size_t i = 0; i < ops; i++) {
+				if (!mine.empty() && rng() % 3 == 0) {
+					booking.Release(mine.back());
+					mine.pop_back();
+					continue;
+				}
+				uint32_t row = rng() % booking.Size();
+				if (booking.Reserve(row)) {
+					mine.push_back(row);
+					count++;
+				}
+			}
+			booked[t] = count;
+		});
+	}
+	for (thread& worker : workers)
+		worker.join();
+	double seconds = chrono::duration<double>(
+		chrono::steady_clock::now() - start).count();
+
+	// Every bed is either free or held by a thread
+	vector<int> taken(hospitals.Size());
+	for (const vector<uint32_t>& mine : held)
+		for (uint32_t row : mine)
+			taken[row]++;
+	bool consistent = true;
+	for (uint32_t i = 0; i < hospitals.Size(); i++)
+		if (booking.FreeBeds(i) < 0
+			|| booking.FreeBeds(i) + taken[i] != hospitals.Beds()[i])
+			consistent = false;
+
+	// and the running totals agree with the counters
+	vector<long long> city_beds(stats.CityCount());
+	for (uint32_t i = 0; i < hospitals.Size(); i++) {
+		city_beds[hospitals.CityId(i)] += booking.FreeBeds(i);
+		if (stats.FreeBeds(i) != booking.FreeBeds(i))
+			consistent = false;
+	}
+	for (uint32_t c = 0; c < stats.CityCount(); c++)
+		if (stats.CityFreeBeds(c) != city_beds[c])
+			consistent = false;
+
+	size_t total = accumulate(booked.begin(), booked.end(), size_t(0));
+	cout << setw(8) << threads
+		<< setw(16) << fixed << setprecision(0) << total / seconds
+		<< setw(14) << setprecision(3) << seconds
+		<< setw(12) << (consistent ? "ok" : "MISMATCH")
+		<< endl;
+}
+
+// Every thread books until nothing is left. The number
+// of successful bookings must be exactly the number of
+// beds, whatever the interleaving.
+bool CheckNoOverbooking(int threads)
+{
+	HospitalTable hospitals = MakeHospitals(8, 5000);
+	BedBookingEngine booking(hospitals);
+	const vector<uint32_t>& cheapest = hospitals.SortedBy(BY_PRICE);
+
+	atomic<long long> booked(0);
+	vector<thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&] {
+			while (booking.ReserveFirst(cheapest)
+				!= BedBookingEngine::npos)
+				booked.fetch_add(1, memory_order_relaxed);
+		});
+	}
+	for (thread& worker : workers)
+		worker.join();
+
+	for (uint32_t i = 0; i < booking.Size(); i++)
+		if (booking.FreeBeds(i) != 0)
+			return false;
+	return booked.load() == hospitals.TotalFreeBeds();
+}
+
+// Exports hospitals and patients to CSV and imports
+// them again. Every field must come back; patients come
+// back waiting, since the importer drops allotments.
+bool CheckCsvRoundTrip()
+{
+	HospitalTable hospitals;
+	Hospital h;
+	for (int i = 0; i < 300; i++) {
+		h.H_name = "H" + to_string(i);
+		h.location = "City" + to_string(i % 7);
+		h.available_beds = i % 9;
+		h.rating = i / 7.0f;
+		h.contact = "000000XXX" + to_string(i % 10);
+		h.doctor_name = "D" + to_string(i % 11);
+		h.price = 100 + i;
+		// Every third hospital has no position
+		h.latitude = i % 3 ? i * 0.29f - 45 : NAN;
+		h.longitude = i % 3 ? i * 0.57f - 90 : NAN;
+		hospitals.AddHospital(h);
+	}
+	PatientTable patients;
+	for (int i = 0; i < 200; i++) {
+		uint32_t row = patients.AddPatient("P" + to_string(i), i,
+			"12345XXX" + to_string(i % 10), "City" + to_string(i % 7),
+			1000 + i);
+		if (i % 2 == 0)
+			patients.SetHospital(row, i);
+	}
+
+	filesystem::path dir = filesystem::temp_directory_path();
+	string hospitals_csv = (dir / "hmt_bench_export_hospitals.csv").string();
+	string patients_csv = (dir / "hmt_bench_export_patients.csv").string();
+	HospitalTable hospitals_in;
+	PatientTable patients_in;
+	ImportStats stats;
+	bool ok = ExportData(hospitals_csv, hospitals, nullptr)
+		&& ExportData(patients_csv, hospitals, &patients)
+		&& ImportHospitalsCsv(hospitals_csv, hospitals_in, stats)
+		&& ImportPatientsCsv(patients_csv, patients_in, stats)
+		&& stats.errors.empty()
+		&& hospitals_in.Size() == hospitals.Size()
+		&& patients_in.Size() == patients.Size();
+	filesystem::remove(hospitals_csv);
+	filesystem::remove(patients_csv);
+
+	auto same = [](float a, float b) {
+		return a == b || (isnan(a) && isnan(b));
+	};
+	for (uint32_t i = 0; ok && i < hospitals.Size(); i++)
+		ok = hospitals_in.Name(i) == hospitals.Name(i)
+			&& hospitals_in.Location(i) == hospitals.Location(i)
+			&& hospitals_in.Contact(i) == hospitals.Contact(i)
+			&& hospitals_in.Doctor(i) == hospitals.Doctor(i)
+			&& hospitals_in.Beds()[i] == hospitals.Beds()[i]
+			&& hospitals_in.Ratings()[i] == hospitals.Ratings()[i]
+			&& hospitals_in.Prices()[i] == hospitals.Prices()[i]
+			&& same(hospitals_in.Latitudes()[i], hospitals.Latitudes()[i])
+			&& same(hospitals_in.Longitudes()[i], hospitals.Longitudes()[i]);
+	for (uint32_t i = 0; ok && i < patients.Size(); i++)
+		ok = patients_in.Name(i) == patients.Name(i)
+			&& patients_in.Id(i) == patients.Id(i)
+			&& patients_in.Contact(i) == patients.Contact(i)
+			&& patients_in.City(i) == patients.City(i)
+			&& patients_in.Expenditure(i) == patients.Expenditure(i)
+			&& patients_in.HospitalOf(i) == PatientTable::npos;
+	return ok;
+}
+
+// Every thread logs admissions to a scratch log. Group
+// commit lets concurrent events share one fsync, so the
+// events per sync should grow with the thread count.
+void BenchWal(int threads, size_t events)
+{
+	string path = (filesystem::temp_directory_path()
+		/ ("hmt_bench_" + to_string(threads) + ".wal")).string();
+	filesystem::remove(path);
+	WriteAheadLog log;
+	string error;
+	if (!log.Open(path, NewWalGeneration(), 0, &error)) {
+		cerr << error << endl;
+		return;
+	}
+
+	atomic<size_t> failed(0);
+	auto start = chrono::steady_clock::now();
+	vector<thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&, t] {
+			for (size_t i = 0; i < events; i++)
+				if (!log.Append(WAL_ADMIT, uint32_t(i), t))
+					failed.fetch_add(1, memory_order_relaxed);
+		});
+	}
+	for (thread& worker : workers)
+		worker.join();
+	double seconds = chrono::duration<double>(
+		chrono::steady_clock::now() - start).count();
+
+	size_t total = threads * events;
+	uint64_t syncs = log.Syncs();
+	log.Close();
+	filesystem::remove(path);
+	cout << setw(8) << threads
+		<< setw(16) << fixed << setprecision(0) << total / seconds
+		<< setw(14) << setprecision(1) << double(total) / max<uint64_t>(syncs, 1)
+		<< setw(12) << (failed.load() == 0 ? "ok" : "FAILED")
+		<< endl;
+}
+
+// Draws ranks 0..n-1 with probability proportional to
+// 1 / (rank + 1)^s, so a few cities get most of the
+// hospitals and patients, like real ones
+class ZipfSampler {
+public:
+	ZipfSampler(size_t n, double s)
+		: cdf(n)
+	{
+		double total = 0;
+		for (size_t i = 0; i < n; i++)
+			cdf[i] = total += 1 / pow(i + 1.0, s);
+		for (double& c : cdf)
+			c /= total;
+	}
+
+	template <typename Rng>
+	uint32_t operator()(Rng& rng) const
+	{
+		double u = uniform_real_distribution<double>(0, 1)(rng);
+		return min<size_t>(lower_bound(cdf.begin(), cdf.end(), u)
+							   - cdf.begin(),
+			cdf.size() - 1);
+	}
+
+private:
+	vector<double> cdf;
+};
+
+long long HeapBytes()
+{
+	return heap_bytes.load(memory_order_relaxed);
+}
+
+string CityName(uint32_t rank)
+{
+	return "City" + to_string(rank);
+}
+
+// Writes hospitals.csv and patients.csv for a synthetic
+// country: cities by Zipf rank with a centre somewhere in
+// India, and hospitals and patients spread over them by
+// the same distribution. Ratings cluster around 3.8,
+// bed counts and prices are skewed, and better rated
+// hospitals charge more.
+void GenerateWorkload(const string& hospitals_csv, const string& patients_csv,
+	size_t count, const ZipfSampler& cities, size_t city_count)
+{
+	mt19937_64 rng(count);
+	vector<pair<float, float>> centres(city_count);
+	uniform_real_distribution<float> lat(8, 34), lon(68, 97);
+	for (auto& c : centres)
+		c = { lat(rng), lon(rng) };
+
+	normal_distribution<float> stars(3.8f, 0.6f);
+	lognormal_distribution<double> bed_count(4, 0.8), markup(0, 0.3);
+	uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+	uniform_int_distribution<int> cost(500, 5000), digits(0, 99999);
+
+	{
+		ofstream file(hospitals_csv, ios::binary);
+		TableRenderer out(file, RENDER_CSV);
+		out.Columns({ "name", "location", "beds", "rating", "contact",
+			"doctor", "price", "latitude", "longitude" });
+		for (size_t i = 0; i < count; i++) {
+			uint32_t city = cities(rng);
+			float rating = round(clamp(stars(rng), 1.0f, 5.0f) * 10) / 10;
+			out.Add("Hospital " + to_string(i));
+			out.Add(CityName(city));
+			out.Add(int(clamp(bed_count(rng), 5.0, 2000.0)));
+			out.Add(rating);
+			out.Add("98" + to_string(10000000 + digits(rng) * 37));
+			out.Add("Dr " + to_string(i % 5000));
+			out.Add(int(rating * 200 * markup(rng)) + 100);
+			out.Add(centres[city].first + jitter(rng));
+			out.Add(centres[city].second + jitter(rng));
+			out.EndRow();
+		}
+	}
+
+	ofstream file(patients_csv, ios::binary);
+	TableRenderer out(file, RENDER_CSV);
+	out.Columns({ "name", "id", "contact", "city", "expenditure" });
+	for (size_t i = 0; i < count; i++) {
+		out.Add("Patient " + to_string(i));
+		out.Add(int(i + 1));
+		out.Add("97" + to_string(10000000 + digits(rng) * 37));
+		out.Add(CityName(cities(rng)));
+		out.Add(cost(rng));
+		out.EndRow();
+	}
+}
+
+// One line of the workload report
+void Report(const string& stage, size_t count, double seconds)
+{
+	cout << "  " << left << setw(26) << stage << right
+		<< setw(12) << count
+		<< setw(12) << fixed << setprecision(4) << seconds
+		<< setw(16) << setprecision(0) << count / max(seconds, 1e-9)
+		<< endl;
+}
+
+template <typename Work>
+double Time(Work work)
+{
+	auto start = chrono::steady_clock::now();
+	work();
+	return chrono::duration<double>(
+		chrono::steady_clock::now() - start).count();
+}
+
+// Runs the end to end workload at one scale: load from
+// CSV, save and reopen the data file, build the sorted
+// views, answer city and top-k queries, and admit every
+// patient from several threads at once. Reports each
+// stage's rate and the memory each record costs.
+void BenchWorkload(size_t count, int threads)
+{
+	size_t city_count = clamp<size_t>(count / 100, 10, 5000);
+	ZipfSampler cities(city_count, 1.0);
+	filesystem::path dir = filesystem::temp_directory_path();
+	string hospitals_csv = (dir / "hmt_bench_hospitals.csv").string();
+	string patients_csv = (dir / "hmt_bench_patients.csv").string();
+	string data_file = (dir / "hmt_bench.hmt").string();
+
+	cout << "Workload: " << count << " hospitals and patients in "
+		<< city_count << " cities (Zipf s=1)" << endl;
+	cout << "  " << left << setw(26) << "stage" << right
+		<< setw(12) << "count"
+		<< setw(12) << "seconds"
+		<< setw(16) << "per sec"
+		<< endl;
+
+	Report("generate csv", 2 * count, Time([&] {
+		GenerateWorkload(hospitals_csv, patients_csv, count, cities,
+			city_count);
+	}));
+
+	HospitalTable hospitals;
+	PatientTable patients;
+	ImportStats stats;
+	string error;
+	long long before = HeapBytes();
+	double seconds = Time([&] {
+		ImportHospitalsCsv(hospitals_csv, hospitals, stats, &error);
+	});
+	long long hospital_bytes = HeapBytes() - before;
+	Report("load hospitals csv", hospitals.Size(), seconds);
+
+	before = HeapBytes();
+	seconds = Time([&] {
+		ImportPatientsCsv(patients_csv, patients, stats, &error);
+	});
+	long long patient_bytes = HeapBytes() - before;
+	Report("load patients csv", patients.Size(), seconds);
+	if (hospitals.Size() != count || patients.Size() != count) {
+		cerr << "workload load failed: " << error << endl;
+		return;
+	}
+
+	Report("save data file", 2 * count, Time([&] {
+		HospitalStore::Save(data_file, hospitals, patients, &error);
+	}));
+	Report("open data file", 2 * count, Time([&] {
+		HospitalStore store;
+		if (store.Open(data_file, &error)) {
+			hospitals = store.LoadTable();
+			patients = store.LoadPatients();
+		}
+	}));
+
+	// Lookups follow the same skew as the data
+	mt19937 rng(1);
+	size_t lookups = 1000000, found = 0;
+	vector<string> names(lookups);
+	for (string& name : names)
+		name = CityName(cities(rng));
+	Report("city lookup", lookups, Time([&] {
+		for (const string& name : names)
+			found += hospitals.RowsInCity(name).size();
+	}));
+
+	// Top-k queries run once on the freshly loaded table,
+	// which has no sorted views, and again once the sorts
+	// below have built them. Without a view each query
+	// scans every row, so fewer are run at large sizes.
+	auto top_k = [&](const string& stage, size_t queries) {
+		Report(stage, queries, Time([&] {
+			for (size_t q = 0; q < queries; q++)
+				found += hospitals.TopK(BY_RATING, 10).size();
+		}));
+	};
+	auto city_top_k = [&](const string& stage, size_t queries) {
+		Report(stage, queries, Time([&] {
+			for (size_t q = 0; q < queries; q++)
+				HospitalQuery(hospitals)
+					.InCity(names[q])
+					.MinBeds(1)
+					.OrderBy(BY_PRICE)
+					.Limit(10)
+					.ForEach([&](uint32_t) { found++; });
+		}));
+	};
+	size_t cold_queries = clamp<size_t>(100000000 / count, 10, 100000);
+	top_k("top 10 by rating", cold_queries);
+	city_top_k("city top 10 cheapest", min<size_t>(cold_queries, 10000));
+
+	const SortKey keys[] = { BY_NAME, BY_RATING, BY_BEDS, BY_PRICE };
+	const char* key_names[] = { "sort by name", "sort by rating",
+		"sort by beds", "sort by price" };
+	for (int k = 0; k < 4; k++)
+		Report(key_names[k], count,
+			Time([&] { hospitals.SortedBy(keys[k]); }));
+
+	top_k("top 10 by rating (view)", 100000);
+	city_top_k("city top 10 (view)", 10000);
+
+	// Every patient takes the first bed in their city.
+	// Cities are resolved up front so the stage times
+	// booking, not name lookups.
+	vector<uint32_t> patient_cities(patients.Size());
+	for (uint32_t i = 0; i < patients.Size(); i++)
+		patient_cities[i] = hospitals.FindCity(patients.City(i));
+	OccupancyStats occupancy(hospitals);
+	BedBookingEngine booking(hospitals, &occupancy);
+	atomic<size_t> admitted(0);
+	Report("admit " + to_string(threads) + " threads", count, Time([&] {
+		vector<thread> workers;
+		for (int t = 0; t < threads; t++) {
+			workers.emplace_back([&, t] {
+				size_t mine = 0;
+				for (size_t i = t; i < patient_cities.size(); i += threads) {
+					uint32_t city = patient_cities[i];
+					if (city != StringPool::npos
+						&& booking.ReserveFirst(hospitals.RowsInCity(city))
+							!= BedBookingEngine::npos)
+						mine++;
+				}
+				admitted.fetch_add(mine);
+			});
+		}
+		for (thread& worker : workers)
+			worker.join();
+	}));
+
+	cout << "  memory: " << setprecision(1)
+		<< double(hospital_bytes) / count << " bytes/hospital, "
+		<< double(patient_bytes) / count << " bytes/patient; "
+		<< admitted.load() << " admitted (checksum " << found << ")"
+		<< endl;
+
+	filesystem::remove(hospitals_csv);
+	filesystem::remove(patients_csv);
+	filesystem::remove(data_file);
+}
+
+int main(int argc, char* argv[])
+{
+	int max_threads = max(1u, thread::hardware_concurrency());
+	size_t hospital_count = 10000;
+	size_t ops = 1000000;
+	int beds = 1000;
+	size_t wal_events = 2000;
+	vector<size_t> sizes = { 1000, 1000000, 10000000 };
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		string flag = argv[i];
+		if (flag == "--threads")
+			max_threads = max(1, atoi(argv[i + 1]));
+		else if (flag == "--hospitals")
+			hospital_count = max(1L, atol(argv[i + 1]));
+		else if (flag == "--ops")
+			ops = atol(argv[i + 1]);
+		else if (flag == "--beds")
+			beds = atoi(argv[i + 1]);
+		else if (flag == "--wal-events")
+			wal_events = atol(argv[i + 1]);
+		else if (flag == "--sizes") {
+			sizes.clear();
+			stringstream list(argv[i + 1]);
+			string size;
+			while (getline(list, size, ','))
+				if (atol(size.c_str()) > 0)
+					sizes.push_back(atol(size.c_str()));
+		}
+		else {
+			cerr << "unknown flag " << flag << endl;
+			return 1;
+		}
+	}
+
+	HospitalTable hospitals = MakeHospitals(hospital_count, beds);
+	cout << "Bed booking: " << hospital_count << " hospitals, "
+		<< beds << " beds each, " << ops << " ops per thread"
+		<< endl;
+	cout << setw(8) << "threads"
+		<< setw(16) << "bookings/sec"
+		<< setw(14) << "seconds"
+		<< setw(12) << "beds"
+		<< endl;
+
+	vector<int> steps;
+	for (int t = 1; t < max_threads; t *= 2)
+		steps.push_back(t);
+	steps.push_back(max_threads);
+	for (int t : steps)
+		BenchBookings(hospitals, t, ops);
+
+	cout << "Write-ahead log: " << wal_events
+		<< " admissions per thread" << endl;
+	cout << setw(8) << "threads"
+		<< setw(16) << "events/sec"
+		<< setw(14) << "events/sync"
+		<< setw(12) << "log"
+		<< endl;
+	for (int t : steps)
+		BenchWal(t, wal_events);
+
+	bool exact = CheckNoOverbooking(max_threads);
+	cout << "Overbooking check with " << max_threads << " threads: "
+		<< (exact ? "ok" : "FAILED") << endl;
+	bool round_trip = CheckCsvRoundTrip();
+	cout << "CSV export/import round trip: "
+		<< (round_trip ? "ok" : "FAILED") << endl;
+
+	for (size_t size : sizes)
+		BenchWorkload(size, max_threads);
+	return exact && round_trip ? 0 : 1;
+}
@@ -17,20 +17,52 @@
  #include <memory>
  #include <stdexcept>
  #include <cstdio>
+ #include <cstring>
  #include <thread>
  #include <ctime>
  #include <cctype>
+ #include <cerrno>
+ #include <cstdlib>
+ #include <functional>
+ #include <atomic>
+ #include <cstdint>
+ #include <deque>
+ #include <mutex>
+ #include <condition_variable>
+ #include <set>
+ #include <future>
+ #include <unordered_map>
+ #include <unordered_set>
+ #include <chrono>
+ #include "termbot_plugin.h"
   #ifdef _WIN32
  #include <windows.h>
  #include <shlobj.h>
  #elif __APPLE__
  #include <unistd.h>
  #include <pwd.h>
+ #include <signal.h>
+ #include <dirent.h>
+ #include <dlfcn.h>
+ #include <fcntl.h>
+ #include <grp.h>
+ #include <poll.h>
+ #include <sys/ioctl.h>
  #include <sys/stat.h>
+ #include <sys/wait.h>
  #else // Linux
  #include <unistd.h>
  #include <pwd.h>
+ #include <signal.h>
+ #include <dirent.h>
+ #include <dlfcn.h>
+ #include <fcntl.h>
+ #include <grp.h>
+ #include <poll.h>
+ #include <sys/ioctl.h>
  #include <sys/stat.h>
+ #include <sys/wait.h>
+ #include <sys/syscall.h>
  #endif
  
  // Terminal color codes
@@ -110,6 +142,124 @@
      std::cout.flush();
  }
  
+ // Repaints a full-screen view with as little terminal output as possible.
+ // Each frame is diffed line by line (LCS) against the previous one: changed
+ // lines are rewritten in place, and inserted or removed runs use the
+ // terminal's insert/delete-line codes so the rest of the screen is not resent.
+ class ScreenRenderer {
+ public:
+     // `screenRows` bounds how far lines may be pushed down while inserting;
+     // if a diff could push content off-screen, rows are rewritten instead.
+     void render(const std::vector<std::string>& lines, int screenRows) {
+         std::string frame;
+         if (!started || !diffFrame(lines, screenRows, frame)) {
+             frame = started ? "" : "\033[2J";
+             positionalFrame(lines, frame);
+             started = true;
+         }
+         frame += moveTo(lines.size());
+         previous = lines;
+         std::cout << frame << std::flush;
+     }
+ 
+ private:
+     std::vector<std::string> previous;
+     bool started = false;
+ 
+     static std::string moveTo(size_t row) {
+         return "\033[" + std::to_string(row + 1) + ";1H";
+     }
+ 
+     void positionalFrame(const std::vector<std::string>& lines, std::string& frame) const {
+         for (size_t row = 0; row < lines.size(); ++row) {
+             if (row < previous.size() && previous[row] == lines[row]) continue;
+             frame += moveTo(row) + lines[row] + "\033[K";
+         }
+         for (size_t row = lines.size(); row < previous.size(); ++row) {
+             frame += moveTo(row) + "\033[K";
+         }
+     }
+ 
+     bool diffFrame(const std::vector<std::string>& lines, int screenRows, std::string& frame) const {
+         const size_t n = previous.size(), m = lines.size();
+         if (screenRows <= 0 || (n + 1) * (m + 1) > 1000000) return false;
+ 
+         // lcs[i][j] = length of the LCS of previous[i..] and lines[j..].
+         std::vector<int> lcs((n + 1) * (m + 1), 0);
+         auto at = [m](size_t i, size_t j) { return i * (m + 1) + j; };
+         for (size_t i = n; i-- > 0;) {
+             for (size_t j = m; j-- > 0;) {
+                 lcs[at(i, j)] = previous[i] == lines[j] ? lcs[at(i + 1, j + 1)] + 1
+                                                          : std::max(lcs[at(i + 1, j)], lcs[at(i, j + 1)]);
+             }
+         }
+ 
+         size_t i = 0, j = 0, row = 0, onScreen = n;
+         while (i < n || j < m) {
+             if (i < n && j < m && previous[i] == lines[j]) {
+                 i++, j++, row++;
+                 continue;
+             }
+             // Collect one hunk of removed and added lines.
+             size_t removed = 0, firstAdded = j;
+             while ((i < n || j < m) && !(i < n && j < m && previous[i] == lines[j])) {
+                 if (j < m && (i == n || lcs[at(i, j + 1)] >= lcs[at(i + 1, j)])) j++;
+                 else i++, removed++;
+             }
+             size_t added = j - firstAdded;
+             size_t replaced = std::min(removed, added);
+             for (size_t k = 0; k < replaced; ++k) {
+                 frame += moveTo(row++) + lines[firstAdded + k] + "\033[K";
+             }
+             if (removed > added) {
+                 frame += moveTo(row) + "\033[" + std::to_string(removed - added) + "M";
+                 onScreen -= removed - added;
+             } else if (added > removed) {
+                 onScreen += added - removed;
+                 if (onScreen >= static_cast<size_t>(screenRows)) return false;
+                 frame += moveTo(row) + "\033[" + std::to_string(added - removed) + "L";
+                 for (size_t k = replaced; k < added; ++k) {
+                     frame += moveTo(row++) + lines[firstAdded + k] + "\033[K";
+                 }
+             }
+         }
+         return true;
+     }
+ };
+ 
+ void terminalSize(int& rows, int& columns) {
+     rows = 24;
+     columns = 80;
+ #ifdef _WIN32
+     CONSOLE_SCREEN_BUFFER_INFO info;
+     if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+         rows = info.srWindow.Bottom - info.srWindow.Top + 1;
+         columns = info.srWindow.Right - info.srWindow.Left + 1;
+     }
+ #else
+     winsize size;
+     if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0 && size.ws_col > 0) {
+         rows = size.ws_row;
+         columns = size.ws_col;
+     }
+ #endif
+ }
+ 
+ // Waits up to `milliseconds` for a line on stdin. Returns true (and consumes
+ // the line) if the user pressed Enter, which is how watch views are stopped.
+ bool waitForEnter(int milliseconds) {
+ #ifdef _WIN32
+     std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+     return true;
+ #else
+     pollfd input{STDIN_FILENO, POLLIN, 0};
+     if (poll(&input, 1, milliseconds) <= 0) return false;
+     std::string line;
+     std::getline(std::cin, line);
+     return true;
+ #endif
+ }
+ 
  // System utilities
  namespace SystemUtils {
      std::string getOperatingSystem() {
@@ -138,6 +288,18 @@
  #endif
      }
  
+     // std::localtime shares one static buffer; sessions and worker threads
+     // format times concurrently, so use the reentrant variants.
+     std::tm localTime(std::time_t time) {
+         std::tm result{};
+ #ifdef _WIN32
+         localtime_s(&result, &time);
+ #else
+         localtime_r(&time, &result);
+ #endif
+         return result;
+     }
+ 
      bool fileExists(const std::string& filename) {
          std::ifstream file(filename);
          return file.good();
@@ -160,47 +322,1370 @@
  #endif
      }
  
-     bool speakText(const std::string& text) {
+     // Speaks utterances on a dedicated thread so callers never wait on audio.
+     // The queue is small on purpose: when it is full the oldest waiting
+     // utterance is dropped, repeats of a queued text are coalesced, and
+     // anything that waited longer than maxAge is skipped as stale.
+     //
+     // The synthesizer is looked up on PATH when the queue starts. Without
+     // one, or once it fails to launch, enqueue returns false. Utterances that
+     // were queued but then failed are counted in failures().
+     class SpeechQueue {
+     public:
+         SpeechQueue() : available(engineInstalled()), thread(&SpeechQueue::run, this) {}
+ 
+         ~SpeechQueue() {
+             {
+                 std::lock_guard<std::mutex> lock(mutex);
+                 stopping = true;
+ #ifndef _WIN32
+                 if (speaker > 0) kill(speaker, SIGTERM);
+ #endif
+             }
+             wake.notify_all();
+             thread.join();
+         }
+ 
+         SpeechQueue(const SpeechQueue&) = delete;
+         SpeechQueue& operator=(const SpeechQueue&) = delete;
+ 
+         bool enqueue(const std::string& text) {
+             if (text.empty()) return false;
+             {
+                 std::lock_guard<std::mutex> lock(mutex);
+                 if (!available) return false;
+                 for (const auto& queued : pending) {
+                     if (queued.text == text) return true;
+                 }
+                 if (pending.size() == capacity) pending.pop_front();
+                 pending.push_back({text, std::chrono::steady_clock::now()});
+             }
+             wake.notify_one();
+             return true;
+         }
+ 
+         unsigned long failures() {
+             std::lock_guard<std::mutex> lock(mutex);
+             return failed;
+         }
+ 
+     private:
+         struct Utterance {
+             std::string text;
+             std::chrono::steady_clock::time_point queuedAt;
+         };
+ 
+         static const size_t capacity = 4;
+         static constexpr std::chrono::seconds maxAge{10};
+ 
+         std::mutex mutex;
+         std::condition_variable wake;
+         std::deque<Utterance> pending;
+         bool stopping = false;
+         bool available;
+         unsigned long failed = 0;
+ #ifndef _WIN32
+         pid_t speaker = -1;
+ #endif
+         std::thread thread; // last, so everything above exists when it starts
+ 
+         void run() {
+             std::unique_lock<std::mutex> lock(mutex);
+             while (true) {
+                 wake.wait(lock, [this] { return stopping || !pending.empty(); });
+                 if (stopping) return;
+                 Utterance next = std::move(pending.front());
+                 pending.pop_front();
+                 if (std::chrono::steady_clock::now() - next.queuedAt > maxAge) continue;
+                 lock.unlock();
+                 bool spoken = speak(next.text);
+                 lock.lock();
+                 if (!spoken) failed++;
+             }
+         }
+ 
+         static bool engineInstalled() {
  #ifdef _WIN32
-         std::string command = "powershell -Command \"Add-Type -AssemblyName System.Speech; "
-                              "(New-Object System.Speech.Synthesis.SpeechSynthesizer).Speak('" + text + "')\"";
-         return system(command.c_str()) == 0;
- #elif __APPLE__
-         std::string command = "say '" + text + "'";
-         return system(command.c_str()) == 0;
+             return true; // System.Speech ships with Windows
+ #else
+ #ifdef __APPLE__
+             const std::string name = "say";
+ #else
+             const std::string name = "espeak";
+ #endif
+             const char* path = getenv("PATH");
+             std::stringstream dirs(path != nullptr ? path : "/usr/bin:/bin");
+             std::string dir;
+             while (std::getline(dirs, dir, ':')) {
+                 if (!dir.empty() && access((dir + "/" + name).c_str(), X_OK) == 0) return true;
+             }
+             return false;
+ #endif
+         }
+ 
+         // False if the synthesizer could not be run or exited with an error.
+         bool speak(const std::string& text) {
+ #ifdef _WIN32
+             // PowerShell single-quoted strings escape ' by doubling it.
+             std::string quoted;
+             for (char c : text) {
+                 if (c == '\'') quoted += "''";
+                 else if (c != '"') quoted += c;
+             }
+             std::string command = "powershell -Command \"Add-Type -AssemblyName System.Speech; "
+                                  "(New-Object System.Speech.Synthesis.SpeechSynthesizer).Speak('" + quoted + "')\"";
+             return system(command.c_str()) == 0;
+ #else
+             // The text goes to the synthesizer as a single argv entry; no shell
+             // ever parses it.
+ #ifdef __APPLE__
+             const char* argv[] = {"say", "--", text.c_str(), nullptr};
+ #else
+             const char* argv[] = {"espeak", "--", text.c_str(), nullptr};
+ #endif
+             pid_t child = fork();
+             if (child == 0) {
+                 int devNull = open("/dev/null", O_RDWR);
+                 if (devNull >= 0) {
+                     dup2(devNull, STDIN_FILENO);
+                     dup2(devNull, STDOUT_FILENO);
+                     dup2(devNull, STDERR_FILENO);
+                 }
+                 execvp(argv[0], const_cast<char* const*>(argv));
+                 _exit(127);
+             }
+             if (child < 0) return false;
+ 
+             {
+                 std::lock_guard<std::mutex> lock(mutex);
+                 speaker = child;
+                 if (stopping) kill(child, SIGTERM);
+             }
+             int status = 0;
+             while (waitpid(child, &status, 0) < 0 && errno == EINTR) {}
+             std::lock_guard<std::mutex> lock(mutex);
+             speaker = -1;
+             // 127 is the child's exec failure: the engine is gone.
+             if (WIFEXITED(status) && WEXITSTATUS(status) == 127) available = false;
+             return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+ #endif
+         }
+     };
+ 
+     SpeechQueue& speechQueue() {
+         static SpeechQueue queue;
+         return queue;
+     }
+ 
+     // Queues `text` for speech and returns immediately. False for empty text
+     // or when no speech engine is available. True means queued, not spoken:
+     // a later failure shows up in speechFailures().
+     bool speakText(const std::string& text) {
+         return speechQueue().enqueue(text);
+     }
+ 
+     unsigned long speechFailures() {
+         return speechQueue().failures();
+     }
+ }
+ 
+ // Output sinks for the plugin ABI (see termbot_plugin.h)
+ inline void writeOutput(TermBotOutput& out, const std::string& text) {
+     out.write(out.context, text.data(), text.size());
+ }
+ 
+ inline TermBotOutput stringOutput(std::string& target) {
+     return {&target, [](void* context, const char* data, size_t length) {
+         static_cast<std::string*>(context)->append(data, length);
+     }};
+ }
+ 
+ #ifndef _WIN32
+ // Long-lived /bin/sh co-process. Each command is sent over the shell's stdin
+ // followed by a sentinel printf, and output is read back until the sentinel
+ // line arrives, so exec and shell start-up are paid once per session.
+ // Commands run in a ( ... ) subshell, so cd, export, alias and exit affect
+ // only that command, the same as with a fresh popen shell.
+ class ShellSession {
+ public:
+     ShellSession() = default;
+     ~ShellSession() { stop(); }
+ 
+     ShellSession(const ShellSession&) = delete;
+     ShellSession& operator=(const ShellSession&) = delete;
+ 
+     // Returns false only if the shell could not be started or written to;
+     // the caller is then expected to fall back to a one-shot popen.
+     bool run(const std::string& command, TermBotOutput& out) {
+         if (pid <= 0 && !start()) return false;
+ 
+         std::string sentinel = "__TERMBOT_DONE_" + std::to_string(getpid()) + "_" +
+                                std::to_string(++sequence) + "__";
+         // eval keeps a malformed command from swallowing the sentinel line,
+         // and </dev/null stops it from reading the rest of our script.
+         std::string script = "( eval " + quote(command) + " ) </dev/null 2>&1\n"
+                              "printf '\\n%s\\n' '" + sentinel + "'\n";
+         if (!writeAll(script)) {
+             stop();
+             return false;
+         }
+ 
+         const std::string marker = "\n" + sentinel + "\n";
+         std::array<char, 4096> buffer;
+         std::string pending;
+         while (true) {
+             size_t found = pending.find(marker);
+             if (found != std::string::npos) {
+                 if (found > 0) out.write(out.context, pending.data(), found);
+                 return true;
+             }
+             // Hand over everything that cannot be the start of the marker.
+             if (pending.size() >= marker.size()) {
+                 size_t ready = pending.size() - (marker.size() - 1);
+                 out.write(out.context, pending.data(), ready);
+                 pending.erase(0, ready);
+             }
+ 
+             ssize_t n = read(fromShell, buffer.data(), buffer.size());
+             if (n < 0 && errno == EINTR) continue;
+             if (n <= 0) {
+                 // The command ended the shell (exit, exec, syntax error in
+                 // dash...). Keep what it printed and respawn next time.
+                 writeOutput(out, pending);
+                 stop();
+                 return true;
+             }
+             pending.append(buffer.data(), static_cast<size_t>(n));
+         }
+     }
+ 
+ private:
+     pid_t pid = -1;
+     int toShell = -1;
+     int fromShell = -1;
+     unsigned long sequence = 0;
+ 
+     bool start() {
+         int in[2], out[2];
+         if (pipe(in) != 0) return false;
+         if (pipe(out) != 0) {
+             close(in[0]);
+             close(in[1]);
+             return false;
+         }
+         // Neither the shell nor the commands it runs should inherit these;
+         // dup2 below gives the child its own copies without the flag.
+         for (int fd : {in[0], in[1], out[0], out[1]})
+             fcntl(fd, F_SETFD, FD_CLOEXEC);
+ 
+         pid = fork();
+         if (pid < 0) {
+             close(in[0]); close(in[1]);
+             close(out[0]); close(out[1]);
+             return false;
+         }
+         if (pid == 0) {
+             dup2(in[0], STDIN_FILENO);
+             dup2(out[1], STDOUT_FILENO);
+             dup2(out[1], STDERR_FILENO);
+             close(in[0]); close(in[1]);
+             close(out[0]); close(out[1]);
+             execl("/bin/sh", "sh", static_cast<char*>(nullptr));
+             _exit(127);
+         }
+ 
+         close(in[0]);
+         close(out[1]);
+         toShell = in[1];
+         fromShell = out[0];
+         return true;
+     }
+ 
+     void stop() {
+         if (toShell >= 0) close(toShell);
+         if (fromShell >= 0) close(fromShell);
+         toShell = fromShell = -1;
+         if (pid > 0) {
+             kill(pid, SIGTERM);
+             waitpid(pid, nullptr, 0);
+         }
+         pid = -1;
+     }
+ 
+     // A shell that died between commands must not take the host process
+     // down with it. SIGPIPE is blocked on this thread for the write, so the
+     // dead shell shows up as EPIPE, and the SIGPIPE the write raised is
+     // consumed before the mask is restored. The process's own signal
+     // dispositions are left alone.
+     bool writeAll(const std::string& data) {
+         sigset_t pipeSignal, pending, previous;
+         sigemptyset(&pipeSignal);
+         sigaddset(&pipeSignal, SIGPIPE);
+         sigpending(&pending);
+         bool alreadyPending = sigismember(&pending, SIGPIPE);
+         pthread_sigmask(SIG_BLOCK, &pipeSignal, &previous);
+ 
+         size_t written = 0;
+         int error = 0;
+         while (written < data.size()) {
+             ssize_t n = write(toShell, data.data() + written, data.size() - written);
+             if (n < 0 && errno == EINTR) continue;
+             if (n <= 0) {
+                 error = n < 0 ? errno : EIO;
+                 break;
+             }
+             written += static_cast<size_t>(n);
+         }
+ 
+         if (error == EPIPE && !alreadyPending) {
+             int received;
+             sigpending(&pending);
+             if (sigismember(&pending, SIGPIPE)) sigwait(&pipeSignal, &received);
+         }
+         pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+         return error == 0;
+     }
+ 
+     static std::string quote(const std::string& text) {
+         std::string quoted = "'";
+         for (char c : text) {
+             if (c == '\'') quoted += "'\\''";
+             else quoted += c;
+         }
+         return quoted + "'";
+     }
+ };
+ #endif
+ 
+ #ifndef _WIN32
+ // Native replacement for `ls -la` and `du`. Directories are read in large
+ // batches (getdents64 on Linux) and entries are stat'ed relative to the open
+ // directory fd (statx on Linux), so no path is re-resolved per entry.
+ namespace FileSystemEngine {
+     struct EntryStat {
+         mode_t mode = 0;
+         uint64_t nlink = 0;
+         uid_t uid = 0;
+         gid_t gid = 0;
+         uint64_t size = 0;
+         uint64_t blocks = 0;
+         int64_t mtime = 0;
+         uint64_t dev = 0;
+         uint64_t ino = 0;
+     };
+ 
+     struct DirEntry {
+         std::string name;
+     };
+ 
+     // Appends up to `limit` entries of an open directory to `entries`.
+     // Returns false once the directory is exhausted.
+     class DirReader {
+     public:
+         explicit DirReader(int fd) : fd(fd) {
+ #ifndef __linux__
+             dir = fdopendir(dup(fd));
+ #endif
+         }
+ 
+         ~DirReader() {
+ #ifndef __linux__
+             if (dir != nullptr) closedir(dir);
+ #endif
+         }
+ 
+         DirReader(const DirReader&) = delete;
+         DirReader& operator=(const DirReader&) = delete;
+ 
+         bool read(std::vector<DirEntry>& entries, size_t limit) {
+ #ifdef __linux__
+             struct LinuxDirent64 {
+                 uint64_t d_ino;
+                 int64_t d_off;
+                 unsigned short d_reclen;
+                 unsigned char d_type;
+                 char d_name[1];
+             };
+             while (entries.size() < limit) {
+                 if (offset >= filled) {
+                     long n = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+                     if (n <= 0) return false;
+                     filled = static_cast<size_t>(n);
+                     offset = 0;
+                 }
+                 while (offset < filled && entries.size() < limit) {
+                     auto* entry = reinterpret_cast<LinuxDirent64*>(buffer.data() + offset);
+                     offset += entry->d_reclen;
+                     if (!isDotOrDotDot(entry->d_name)) {
+                         entries.push_back({entry->d_name});
+                     }
+                 }
+             }
+             return true;
+ #else
+             if (dir == nullptr) return false;
+             while (entries.size() < limit) {
+                 dirent* entry = readdir(dir);
+                 if (entry == nullptr) return false;
+                 if (!isDotOrDotDot(entry->d_name)) {
+                     entries.push_back({entry->d_name});
+                 }
+             }
+             return true;
+ #endif
+         }
+ 
+     private:
+         int fd;
+ #ifdef __linux__
+         alignas(8) std::array<char, 1 << 16> buffer;
+         size_t filled = 0;
+         size_t offset = 0;
+ #else
+         DIR* dir = nullptr;
+ #endif
+ 
+         static bool isDotOrDotDot(const char* name) {
+             return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+         }
+     };
+ 
+     inline bool statAt(int dirFd, const char* name, EntryStat& st) {
+ #ifdef __linux__
+         struct statx sx;
+         unsigned mask = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID |
+                         STATX_SIZE | STATX_BLOCKS | STATX_MTIME | STATX_INO;
+         if (statx(dirFd, name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, mask, &sx) != 0) return false;
+         st.mode = sx.stx_mode;
+         st.nlink = sx.stx_nlink;
+         st.uid = sx.stx_uid;
+         st.gid = sx.stx_gid;
+         st.size = sx.stx_size;
+         st.blocks = sx.stx_blocks;
+         st.mtime = sx.stx_mtime.tv_sec;
+         st.dev = (static_cast<uint64_t>(sx.stx_dev_major) << 32) | sx.stx_dev_minor;
+         st.ino = sx.stx_ino;
  #else
-         std::string command = "espeak '" + text + "' 2>/dev/null";
-         return system(command.c_str()) == 0;
+         struct stat sb;
+         if (fstatat(dirFd, name, &sb, AT_SYMLINK_NOFOLLOW) != 0) return false;
+         st.mode = sb.st_mode;
+         st.nlink = sb.st_nlink;
+         st.uid = sb.st_uid;
+         st.gid = sb.st_gid;
+         st.size = sb.st_size;
+         st.blocks = sb.st_blocks;
+         st.mtime = sb.st_mtime;
+         st.dev = sb.st_dev;
+         st.ino = sb.st_ino;
  #endif
+         return true;
+     }
+ 
+     inline std::string humanSize(uint64_t bytes) {
+         const char* units[] = {"B", "K", "M", "G", "T", "P"};
+         double value = static_cast<double>(bytes);
+         int unit = 0;
+         while (value >= 1024 && unit < 5) {
+             value /= 1024;
+             unit++;
+         }
+         char text[16];
+         std::snprintf(text, sizeof(text), unit == 0 ? "%.0f%s" : "%.1f%s", value, units[unit]);
+         return text;
+     }
+ 
+     inline unsigned workerCount() {
+         unsigned count = std::thread::hardware_concurrency();
+         return count == 0 ? 4 : std::min(count, 32u);
+     }
+ 
+     // uid/gid -> name lookups are slow (NSS), so each listing worker caches them.
+     class NameCache {
+     public:
+         const std::string& user(uid_t uid) {
+             auto it = users.find(uid);
+             if (it != users.end()) return it->second;
+             passwd* pw = getpwuid(uid);
+             return users[uid] = pw != nullptr ? pw->pw_name : std::to_string(uid);
+         }
+ 
+         const std::string& group(gid_t gid) {
+             auto it = groups.find(gid);
+             if (it != groups.end()) return it->second;
+             struct group* gr = getgrgid(gid);
+             return groups[gid] = gr != nullptr ? gr->gr_name : std::to_string(gid);
+         }
+ 
+     private:
+         std::map<uid_t, std::string> users;
+         std::map<gid_t, std::string> groups;
+     };
+ 
+     inline void formatEntry(const DirEntry& entry, const EntryStat& st, NameCache& names, std::string& line) {
+         char mode[11] = "----------";
+         if (S_ISDIR(st.mode)) mode[0] = 'd';
+         else if (S_ISLNK(st.mode)) mode[0] = 'l';
+         else if (S_ISCHR(st.mode)) mode[0] = 'c';
+         else if (S_ISBLK(st.mode)) mode[0] = 'b';
+         else if (S_ISFIFO(st.mode)) mode[0] = 'p';
+         else if (S_ISSOCK(st.mode)) mode[0] = 's';
+         const char* rwx = "rwxrwxrwx";
+         for (int bit = 0; bit < 9; ++bit) {
+             if (st.mode & (0400 >> bit)) mode[bit + 1] = rwx[bit];
+         }
+ 
+         char when[20];
+         std::time_t mtime = static_cast<std::time_t>(st.mtime);
+         std::tm local = SystemUtils::localTime(mtime);
+         std::strftime(when, sizeof(when), "%b %d %H:%M", &local);
+ 
+         char fixed[96];
+         std::snprintf(fixed, sizeof(fixed), "%s %3llu ", mode, static_cast<unsigned long long>(st.nlink));
+         line += fixed;
+         line += names.user(st.uid);
+         line += ' ';
+         line += names.group(st.gid);
+         std::snprintf(fixed, sizeof(fixed), " %10llu %s ", static_cast<unsigned long long>(st.size), when);
+         line += fixed;
+         line += entry.name;
+         line += '\n';
+     }
+ 
+     // Lists a directory like `ls -la`. Listings that fit in one batch are
+     // sorted by name; larger ones stream in directory order, one batch at a
+     // time, with entries stat'ed and formatted in parallel.
+     inline void listDirectory(const std::string& path, TermBotOutput& out) {
+         int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+         if (fd < 0) {
+             writeOutput(out, "❌ Cannot open " + path + ": " + std::strerror(errno) + "\n");
+             return;
+         }
+ 
+         const size_t batchSize = 65536;
+         DirReader reader(fd);
+         std::vector<NameCache> names(workerCount());
+         std::vector<DirEntry> batch;
+         bool more = true;
+         bool first = true;
+         uint64_t count = 0;
+         while (more) {
+             batch.clear();
+             more = reader.read(batch, batchSize);
+             if (first && !more) {
+                 std::sort(batch.begin(), batch.end(),
+                           [](const DirEntry& a, const DirEntry& b) { return a.name < b.name; });
+             }
+             first = false;
+ 
+             unsigned workers = batch.size() < 1024 ? 1 : workerCount();
+             std::vector<std::string> chunks(workers);
+             auto work = [&](unsigned worker) {
+                 size_t begin = batch.size() * worker / workers;
+                 size_t end = batch.size() * (worker + 1) / workers;
+                 EntryStat st;
+                 for (size_t i = begin; i < end; ++i) {
+                     if (statAt(fd, batch[i].name.c_str(), st)) {
+                         formatEntry(batch[i], st, names[worker], chunks[worker]);
+                     } else {
+                         chunks[worker] += "?????????? " + batch[i].name + "\n";
+                     }
+                 }
+             };
+             std::vector<std::thread> threads;
+             for (unsigned worker = 1; worker < workers; ++worker) threads.emplace_back(work, worker);
+             work(0);
+             for (auto& thread : threads) thread.join();
+ 
+             for (const auto& chunk : chunks) writeOutput(out, chunk);
+             count += batch.size();
+         }
+         close(fd);
+         writeOutput(out, std::to_string(count) + " entries\n");
      }
+ 
+     // Parallel `du -x`: sizes every top-level entry of `root` without crossing
+     // mount points and counting each hard-linked inode once. Directories are
+     // spread over per-worker deques; idle workers steal from the others. Each
+     // top-level directory is printed as soon as its subtree is finished.
+     class DiskUsageWalker {
+     public:
+         explicit DiskUsageWalker(TermBotOutput& out) : out(out) {}
+ 
+         void run(const std::string& root) {
+             int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+             EntryStat rootStat;
+             if (fd < 0 || !statAt(fd, ".", rootStat)) {
+                 writeOutput(out, "❌ Cannot open " + root + ": " + std::strerror(errno) + "\n");
+                 if (fd >= 0) close(fd);
+                 return;
+             }
+             rootDevice = rootStat.dev;
+ 
+             // Top-level entries get their own totals; plain files are summed here.
+             std::vector<DirEntry> entries;
+             DirReader reader(fd);
+             while (reader.read(entries, SIZE_MAX)) {}
+             subtrees.reset(new Subtree[entries.size()]);
+             subtreeCount = entries.size();
+             subtreeNames.reserve(entries.size());
+             const std::string prefix = root == "/" ? "/" : root + "/";
+             auto rootDir = std::make_shared<Directory>(fd);
+ 
+             std::vector<size_t> rootDirIndex;
+             for (size_t i = 0; i < entries.size(); ++i) {
+                 subtreeNames.push_back(prefix + entries[i].name);
+                 EntryStat st;
+                 if (!statAt(fd, entries[i].name.c_str(), st)) continue;
+                 if (S_ISDIR(st.mode) && st.dev == rootDevice) {
+                     subtrees[i].bytes += st.blocks * 512;
+                     rootDirIndex.push_back(i);
+                 } else if (countInode(st)) {
+                     subtrees[i].bytes += st.blocks * 512;
+                     files.fetch_add(1);
+                 }
+             }
+ 
+             workers = workerCount();
+             queues.reset(new WorkQueue[workers]);
+             for (size_t i = 0; i < rootDirIndex.size(); ++i) {
+                 size_t index = rootDirIndex[i];
+                 subtrees[index].pending = 1;
+                 pending.fetch_add(1);
+                 queued.fetch_add(1);
+                 queues[i % workers].push({rootDir, entries[index].name, index});
+             }
+             rootDir.reset();
+ 
+             std::vector<std::thread> threads;
+             for (unsigned worker = 0; worker < workers; ++worker) {
+                 threads.emplace_back(&DiskUsageWalker::work, this, worker);
+             }
+             for (auto& thread : threads) thread.join();
+ 
+             std::vector<size_t> order(subtreeCount);
+             uint64_t total = rootStat.blocks * 512;
+             for (size_t i = 0; i < subtreeCount; ++i) {
+                 order[i] = i;
+                 total += subtrees[i].bytes.load();
+             }
+             size_t shown = std::min<size_t>(order.size(), 10);
+             std::partial_sort(order.begin(), order.begin() + shown, order.end(), [this](size_t a, size_t b) {
+                 return subtrees[a].bytes.load() > subtrees[b].bytes.load();
+             });
+             std::string summary = "\nLargest entries:\n";
+             for (size_t i = 0; i < shown; ++i) {
+                 summary += formatLine(subtrees[order[i]].bytes.load(), subtreeNames[order[i]]);
+             }
+             summary += formatLine(total, root + " (total, " + std::to_string(files.load()) + " files)");
+             if (errors.load() > 0) {
+                 summary += std::to_string(errors.load()) + " entries could not be read\n";
+             }
+             writeOutput(out, summary);
+         }
+ 
+     private:
+         // An open directory, closed when the last task naming an entry in
+         // it is done. Children are opened relative to it, so no path is
+         // rebuilt and a renamed ancestor cannot redirect the walk.
+         struct Directory {
+             int fd;
+             explicit Directory(int fd) : fd(fd) {}
+             ~Directory() { close(fd); }
+             Directory(const Directory&) = delete;
+             Directory& operator=(const Directory&) = delete;
+         };
+ 
+         struct Task {
+             std::shared_ptr<Directory> parent;
+             std::string name;
+             size_t subtree;
+         };
+ 
+         struct Subtree {
+             std::atomic<uint64_t> bytes{0};
+             std::atomic<uint64_t> pending{0};
+         };
+ 
+         // Owner pushes and pops at the back; thieves take from the front,
+         // where the shallower (larger) directories sit.
+         struct WorkQueue {
+             std::mutex mutex;
+             std::deque<Task> tasks;
+ 
+             void push(Task task) {
+                 std::lock_guard<std::mutex> lock(mutex);
+                 tasks.push_back(std::move(task));
+             }
+ 
+             bool pop(Task& task, bool steal) {
+                 std::lock_guard<std::mutex> lock(mutex);
+                 if (tasks.empty()) return false;
+                 if (steal) {
+                     task = std::move(tasks.front());
+                     tasks.pop_front();
+                 } else {
+                     task = std::move(tasks.back());
+                     tasks.pop_back();
+                 }
+                 return true;
+             }
+         };
+ 
+         static const size_t inodeShards = 64;
+         struct InodeShard {
+             std::mutex mutex;
+             std::unordered_set<uint64_t> seen;
+         };
+ 
+         TermBotOutput& out;
+         std::mutex outputMutex;
+         uint64_t rootDevice = 0;
+         unsigned workers = 1;
+         std::unique_ptr<WorkQueue[]> queues;
+         std::unique_ptr<Subtree[]> subtrees;
+         size_t subtreeCount = 0;
+         std::vector<std::string> subtreeNames;
+         std::atomic<uint64_t> pending{0}; // directories not yet scanned
+         std::atomic<uint64_t> queued{0};  // of those, waiting in a queue
+         std::atomic<unsigned> sleepers{0};
+         std::mutex idleMutex;
+         std::condition_variable idle;
+         std::atomic<uint64_t> files{0};
+         std::atomic<uint64_t> errors{0};
+         std::array<InodeShard, inodeShards> inodes;
+ 
+         // Idle workers sleep until a directory is queued or the walk is done.
+         void work(unsigned self) {
+             Task task;
+             while (true) {
+                 bool found = queues[self].pop(task, false);
+                 for (unsigned i = 1; !found && i < workers; ++i) {
+                     found = queues[(self + i) % workers].pop(task, true);
+                 }
+                 if (!found) {
+                     std::unique_lock<std::mutex> lock(idleMutex);
+                     sleepers.fetch_add(1);
+                     idle.wait(lock, [this] { return queued.load() > 0 || pending.load() == 0; });
+                     sleepers.fetch_sub(1);
+                     if (pending.load() == 0) return;
+                     continue;
+                 }
+                 queued.fetch_sub(1);
+                 size_t subtree = task.subtree;
+                 scan(self, task);
+                 if (subtrees[subtree].pending.fetch_sub(1) == 1) finishSubtree(subtree);
+                 if (pending.fetch_sub(1) == 1) {
+                     std::lock_guard<std::mutex> lock(idleMutex);
+                     idle.notify_all();
+                 }
+             }
+         }
+ 
+         void push(unsigned self, Task task) {
+             queues[self].push(std::move(task));
+             queued.fetch_add(1);
+             // A sleeper counts itself under idleMutex before checking
+             // `queued`, so taking the lock here cannot miss it.
+             if (sleepers.load() > 0) {
+                 std::lock_guard<std::mutex> lock(idleMutex);
+                 idle.notify_one();
+             }
+         }
+ 
+         void scan(unsigned self, Task& task) {
+             int fd = openat(task.parent->fd, task.name.c_str(),
+                             O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+             task.parent.reset();
+             if (fd < 0) {
+                 errors.fetch_add(1);
+                 return;
+             }
+             auto dir = std::make_shared<Directory>(fd);
+ 
+             DirReader reader(fd);
+             std::vector<DirEntry> entries;
+             uint64_t bytes = 0;
+             bool more = true;
+             EntryStat st;
+             while (more) {
+                 entries.clear();
+                 more = reader.read(entries, 4096);
+                 for (const auto& entry : entries) {
+                     if (!statAt(fd, entry.name.c_str(), st)) {
+                         errors.fetch_add(1);
+                         continue;
+                     }
+                     if (S_ISDIR(st.mode)) {
+                         if (st.dev != rootDevice) continue;
+                         bytes += st.blocks * 512;
+                         subtrees[task.subtree].pending.fetch_add(1);
+                         pending.fetch_add(1);
+                         push(self, {dir, entry.name, task.subtree});
+                     } else if (countInode(st)) {
+                         bytes += st.blocks * 512;
+                         files.fetch_add(1, std::memory_order_relaxed);
+                     }
+                 }
+             }
+             subtrees[task.subtree].bytes.fetch_add(bytes);
+         }
+ 
+         // False for the second and later sightings of a hard-linked inode.
+         // The walk never leaves rootDevice, so the inode number is the key.
+         bool countInode(const EntryStat& st) {
+             if (st.nlink <= 1 || S_ISDIR(st.mode)) return true;
+             InodeShard& shard = inodes[(st.ino * 0x9E3779B97F4A7C15ULL) >> 58];
+             std::lock_guard<std::mutex> lock(shard.mutex);
+             return shard.seen.insert(st.ino).second;
+         }
+ 
+         void finishSubtree(size_t index) {
+             std::string line = formatLine(subtrees[index].bytes.load(), subtreeNames[index]);
+             std::lock_guard<std::mutex> lock(outputMutex);
+             writeOutput(out, line);
+         }
+ 
+         static std::string formatLine(uint64_t bytes, const std::string& name) {
+             std::string size = humanSize(bytes);
+             return std::string(size.size() < 8 ? 8 - size.size() : 0, ' ') + size + "  " + name + "\n";
+         }
+     };
  }
+ #endif
+ 
+ #ifdef __linux__
+ // In-process `ps`/`top`: scans /proc in parallel batches and keeps the
+ // previous snapshot, so each refresh only re-reads /proc/<pid>/stat for
+ // known processes. status and cmdline are read once, when a pid first shows up.
+ namespace ProcessMonitor {
+     struct ProcessInfo {
+         int pid = 0;
+         char state = '?';
+         uid_t uid = 0;
+         uint64_t cpuTicks = 0;
+         uint64_t startTicks = 0;
+         uint64_t rssKb = 0;
+         int64_t rssDeltaKb = 0;
+         double cpuPercent = 0;
+         std::string command;
+     };
+ 
+     // Reads a small /proc file into `buffer`; returns the number of bytes read.
+     inline size_t readProcFile(const std::string& path, char* buffer, size_t size) {
+         int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+         if (fd < 0) return 0;
+         ssize_t n = read(fd, buffer, size - 1);
+         close(fd);
+         if (n <= 0) return 0;
+         buffer[n] = '\0';
+         return static_cast<size_t>(n);
+     }
+ 
+     class ProcessTable {
+     public:
+         ProcessTable() {
+             ticksPerSecond = sysconf(_SC_CLK_TCK);
+             pageKb = static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) / 1024;
+         }
+ 
+         // Takes a new snapshot. CPU% is measured against the previous
+         // snapshot, or averaged over the process lifetime on the first scan.
+         const std::vector<ProcessInfo>& scan() {
+             std::vector<int> pids = listPids();
+             auto now = std::chrono::steady_clock::now();
+             double elapsed = std::chrono::duration<double>(now - lastScan).count();
+             double uptime = readUptime();
+ 
+             std::vector<ProcessInfo> current(pids.size());
+             std::vector<char> valid(pids.size(), 0);
+             unsigned workers = pids.size() < 512 ? 1 : FileSystemEngine::workerCount();
+             auto work = [&](unsigned worker) {
+                 size_t begin = pids.size() * worker / workers;
+                 size_t end = pids.size() * (worker + 1) / workers;
+                 for (size_t i = begin; i < end; ++i) {
+                     valid[i] = load(pids[i], current[i], elapsed, uptime);
+                 }
+             };
+             std::vector<std::thread> threads;
+             for (unsigned worker = 1; worker < workers; ++worker) threads.emplace_back(work, worker);
+             work(0);
+             for (auto& thread : threads) thread.join();
+ 
+             size_t kept = 0;
+             for (size_t i = 0; i < current.size(); ++i) {
+                 if (!valid[i]) continue;
+                 if (kept != i) current[kept] = std::move(current[i]);
+                 kept++;
+             }
+             current.resize(kept);
+ 
+             snapshot.swap(current);
+             previousByPid.clear();
+             previousByPid.reserve(snapshot.size());
+             for (size_t i = 0; i < snapshot.size(); ++i) previousByPid[snapshot[i].pid] = i;
+             lastScan = now;
+             hasPrevious = true;
+             return snapshot;
+         }
+ 
+     private:
+         std::vector<ProcessInfo> snapshot;
+         std::unordered_map<int, size_t> previousByPid;
+         std::chrono::steady_clock::time_point lastScan;
+         bool hasPrevious = false;
+         long ticksPerSecond = 100;
+         uint64_t pageKb = 4;
+ 
+         static std::vector<int> listPids() {
+             std::vector<int> pids;
+             int fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+             if (fd < 0) return pids;
+             FileSystemEngine::DirReader reader(fd);
+             std::vector<FileSystemEngine::DirEntry> entries;
+             while (reader.read(entries, SIZE_MAX)) {}
+             close(fd);
+             for (const auto& entry : entries) {
+                 if (std::isdigit(static_cast<unsigned char>(entry.name[0]))) {
+                     pids.push_back(std::atoi(entry.name.c_str()));
+                 }
+             }
+             return pids;
+         }
+ 
+         static double readUptime() {
+             char buffer[128];
+             return readProcFile("/proc/uptime", buffer, sizeof(buffer)) ? std::atof(buffer) : 0;
+         }
+ 
+         bool load(int pid, ProcessInfo& info, double elapsed, double uptime) {
+             const std::string dir = "/proc/" + std::to_string(pid);
+             char buffer[4096];
+             if (!readProcFile(dir + "/stat", buffer, sizeof(buffer))) return false;
+ 
+             // The command name may contain spaces and parentheses; fields
+             // resume after the last ')'.
+             char* close = std::strrchr(buffer, ')');
+             if (close == nullptr) return false;
+             info.pid = pid;
+             info.state = close[2];
+             // After the state: ppid pgrp session tty_nr tpgid flags minflt
+             // cminflt majflt cmajflt utime(10) stime(11) cutime cstime priority
+             // nice num_threads itrealvalue starttime(18) vsize rss(20).
+             long long values[21] = {0};
+             char* field = close + 3;
+             for (int i = 0; i < 21; ++i) values[i] = std::strtoll(field, &field, 10);
+             info.cpuTicks = static_cast<uint64_t>(values[10] + values[11]);
+             info.startTicks = static_cast<uint64_t>(values[18]);
+             info.rssKb = static_cast<uint64_t>(values[20]) * pageKb;
+ 
+             auto known = hasPrevious ? previousByPid.find(pid) : previousByPid.end();
+             if (known != previousByPid.end() && snapshot[known->second].startTicks == info.startTicks) {
+                 const ProcessInfo& before = snapshot[known->second];
+                 info.uid = before.uid;
+                 info.command = before.command;
+                 info.rssDeltaKb = static_cast<int64_t>(info.rssKb) - static_cast<int64_t>(before.rssKb);
+                 double ticks = static_cast<double>(info.cpuTicks - std::min(info.cpuTicks, before.cpuTicks));
+                 info.cpuPercent = elapsed > 0 ? 100.0 * ticks / ticksPerSecond / elapsed : 0;
+                 return true;
+             }
+ 
+             double lifetime = uptime - static_cast<double>(info.startTicks) / ticksPerSecond;
+             info.cpuPercent = lifetime > 0 ? 100.0 * info.cpuTicks / ticksPerSecond / lifetime : 0;
+ 
+             if (readProcFile(dir + "/status", buffer, sizeof(buffer))) {
+                 const char* uid = std::strstr(buffer, "\nUid:");
+                 if (uid != nullptr) info.uid = static_cast<uid_t>(std::strtoul(uid + 5, nullptr, 10));
+             }
+             size_t length = readProcFile(dir + "/cmdline", buffer, 512);
+             if (length > 0) {
+                 std::replace_if(buffer, buffer + length,
+                                 [](char c) { return static_cast<unsigned char>(c) < 0x20; }, ' ');
+                 info.command.assign(buffer, length);
+                 info.command.erase(info.command.find_last_not_of(' ') + 1);
+             } else {
+                 // Kernel threads have no cmdline; show [comm] like ps does.
+                 if (readProcFile(dir + "/comm", buffer, sizeof(buffer))) {
+                     info.command = "[" + std::string(buffer, std::strcspn(buffer, "\n")) + "]";
+                 }
+             }
+             return true;
+         }
+     };
+ 
+     inline std::string formatRow(const ProcessInfo& info, FileSystemEngine::NameCache& names) {
+         char row[96];
+         std::snprintf(row, sizeof(row), "%7d %-10.10s %6.1f %10llu %+9lld %c ",
+                       info.pid, names.user(info.uid).c_str(), info.cpuPercent,
+                       static_cast<unsigned long long>(info.rssKb),
+                       static_cast<long long>(info.rssDeltaKb), info.state);
+         return row + info.command;
+     }
+ 
+     inline const char* header() {
+         return "    PID USER         %CPU    RSS(KB)   ΔRSS(KB) S COMMAND";
+     }
+ 
+     // Busiest processes first; ties broken by RSS, then pid for a stable order.
+     inline void sortByActivity(std::vector<const ProcessInfo*>& rows) {
+         std::sort(rows.begin(), rows.end(), [](const ProcessInfo* a, const ProcessInfo* b) {
+             if (a->cpuPercent != b->cpuPercent) return a->cpuPercent > b->cpuPercent;
+             if (a->rssKb != b->rssKb) return a->rssKb > b->rssKb;
+             return a->pid < b->pid;
+         });
+     }
+ 
+     inline void listProcesses(TermBotOutput& out) {
+         ProcessTable table;
+         const auto& snapshot = table.scan();
+         std::vector<const ProcessInfo*> rows;
+         rows.reserve(snapshot.size());
+         for (const auto& info : snapshot) rows.push_back(&info);
+         sortByActivity(rows);
+ 
+         FileSystemEngine::NameCache names;
+         std::string text = std::string(header()) + "\n";
+         for (const ProcessInfo* info : rows) {
+             text += formatRow(*info, names);
+             text += '\n';
+         }
+         text += std::to_string(rows.size()) + " processes\n";
+         writeOutput(out, text);
+     }
+ }
+ #endif
+ 
+ // Runs queued jobs one at a time on a dedicated thread. Jobs still queued
+ // at destruction are dropped; the one in progress is waited for.
+ class BackgroundWorker {
+ public:
+     BackgroundWorker() : thread(&BackgroundWorker::run, this) {}
+ 
+     ~BackgroundWorker() {
+         {
+             std::lock_guard<std::mutex> lock(mutex);
+             stopping = true;
+         }
+         wake.notify_all();
+         thread.join();
+     }
+ 
+     BackgroundWorker(const BackgroundWorker&) = delete;
+     BackgroundWorker& operator=(const BackgroundWorker&) = delete;
+ 
+     void post(std::function<void()> job) {
+         {
+             std::lock_guard<std::mutex> lock(mutex);
+             jobs.push_back(std::move(job));
+         }
+         wake.notify_one();
+     }
+ 
+     bool idle() const {
+         std::lock_guard<std::mutex> lock(mutex);
+         return jobs.empty() && !busy;
+     }
+ 
+ private:
+     mutable std::mutex mutex;
+     std::condition_variable wake;
+     std::deque<std::function<void()>> jobs;
+     bool stopping = false;
+     bool busy = false;
+     std::thread thread; // last, so everything above exists when it starts
+ 
+     void run() {
+         std::unique_lock<std::mutex> lock(mutex);
+         while (true) {
+             wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+             if (stopping) return;
+             std::function<void()> job = std::move(jobs.front());
+             jobs.pop_front();
+             busy = true;
+             lock.unlock();
+             job();
+             lock.lock();
+             busy = false;
+         }
+     }
+ };
+ 
+ // Per-command result cache with stale-while-revalidate. Fresh entries are
+ // returned as-is; expired ones are returned immediately while a background
+ // refresh replaces them. TTLs come from data/cache_ttl.txt (command=seconds)
+ // and entries persist in data/result_cache.txt across restarts.
+ class ResultCache {
+ public:
+     // Produces a new value; returns false if it should not be cached.
+     using Fetch = std::function<bool(std::string& value)>;
+ 
+     explicit ResultCache(const std::string& directory) : storePath(directory + "/result_cache.txt") {
+         SystemUtils::createDirectoryIfNotExists(directory);
+         loadTtls(directory + "/cache_ttl.txt");
+         load();
+     }
+ 
+     bool cacheable(const std::string& command) const {
+         return ttls.count(command) > 0;
+     }
+ 
+     std::string get(const std::string& command, const Fetch& fetch) {
+         {
+             std::lock_guard<std::mutex> lock(mutex);
+             auto it = entries.find(command);
+             if (it != entries.end()) {
+                 bool expired = std::time(nullptr) - it->second.storedAt >= ttls.at(command);
+                 if (expired && refreshing.insert(command).second) {
+                     worker.post([this, command, fetch] {
+                         std::string fresh;
+                         bool ok = fetch(fresh);
+                         std::lock_guard<std::mutex> lock(mutex);
+                         refreshing.erase(command);
+                         if (ok) store(command, fresh);
+                     });
+                 }
+                 return it->second.value;
+             }
+         }
+ 
+         std::string value;
+         if (fetch(value)) {
+             std::lock_guard<std::mutex> lock(mutex);
+             store(command, value);
+         }
+         return value;
+     }
+ 
+ private:
+     struct Entry {
+         std::string value;
+         std::time_t storedAt;
+     };
+ 
+     std::string storePath;
+     std::map<std::string, long> ttls;
+     std::map<std::string, Entry> entries;
+     std::set<std::string> refreshing;
+     std::mutex mutex;
+     BackgroundWorker worker; // last, so refresh jobs finish before the maps go away
+ 
+     void loadTtls(const std::string& path) {
+         ttls = {{"get_system_info", 86400}, {"get_ip_address", 300}, {"get_weather", 900}};
+ 
+         std::ifstream file(path);
+         if (!file.is_open()) {
+             std::ofstream defaults(path);
+             for (const auto& ttl : ttls) defaults << ttl.first << "=" << ttl.second << std::endl;
+             return;
+         }
+ 
+         std::string line;
+         while (std::getline(file, line)) {
+             size_t pos = line.find('=');
+             if (pos == std::string::npos) continue;
+             long seconds = std::atol(line.c_str() + pos + 1);
+             if (seconds > 0) ttls[line.substr(0, pos)] = seconds;
+             else ttls.erase(line.substr(0, pos));
+         }
+     }
+ 
+     // One entry per line: command<TAB>stored-at<TAB>value, with \, tab and
+     // newline escaped in the value.
+     void load() {
+         std::ifstream file(storePath);
+         std::string line;
+         while (std::getline(file, line)) {
+             size_t first = line.find('\t');
+             size_t second = first == std::string::npos ? first : line.find('\t', first + 1);
+             if (second == std::string::npos) continue;
+             std::string command = line.substr(0, first);
+             if (!cacheable(command)) continue;
+             std::time_t storedAt = static_cast<std::time_t>(std::atoll(line.c_str() + first + 1));
+             entries[command] = {unescape(line.substr(second + 1)), storedAt};
+         }
+     }
+ 
+     void store(const std::string& command, const std::string& value) {
+         entries[command] = {value, std::time(nullptr)};
+ 
+         std::ofstream file(storePath, std::ios::trunc);
+         if (!file.is_open()) return;
+         for (const auto& entry : entries) {
+             file << entry.first << '\t' << entry.second.storedAt << '\t' << escape(entry.second.value) << '\n';
+         }
+     }
+ 
+     static std::string escape(const std::string& text) {
+         std::string escaped;
+         escaped.reserve(text.size());
+         for (char c : text) {
+             if (c == '\\') escaped += "\\\\";
+             else if (c == '\n') escaped += "\\n";
+             else if (c == '\t') escaped += "\\t";
+             else escaped += c;
+         }
+         return escaped;
+     }
+ 
+     static std::string unescape(const std::string& text) {
+         std::string value;
+         value.reserve(text.size());
+         for (size_t i = 0; i < text.size(); ++i) {
+             if (text[i] != '\\' || i + 1 == text.size()) {
+                 value += text[i];
+                 continue;
+             }
+             char next = text[++i];
+             value += next == 'n' ? '\n' : next == 't' ? '\t' : next;
+         }
+         return value;
+     }
+ };
  
  // CommandHandler definition
  class CommandHandler {
+     friend class TermBotBench;
+ 
  public:
-     CommandHandler() {
+     explicit CommandHandler(const std::string& dataDirectory = "data") : cache(dataDirectory) {
          dangerousCommands = {
              "rm -rf", "rmdir /s", "deltree", "format", "shutdown", "reboot",
              ":(){:|:&};:", "fork bomb", "dd if=/dev/zero", "chmod -R 777", "mkfs",
              "> /dev/sda", "> /dev/hda", "wget", "curl | sh"
          };
+ 
+         registerHandler("get_system_info", [this](const std::string&, TermBotOutput& out) {
+             writeOutput(out, getSystemInfo());
+         });
+         registerHandler("get_memory_info", [this](const std::string&, TermBotOutput& out) {
+             writeOutput(out, getMemoryInfo());
+         });
+         registerHandler("get_ip_address", [this](const std::string&, TermBotOutput& out) {
+             writeOutput(out, getIPAddress());
+         });
+         registerHandler("get_weather", [this](const std::string&, TermBotOutput& out) {
+             writeOutput(out, getWeather());
+         });
+ #ifndef _WIN32
+         registerHandler("list_files", [](const std::string& args, TermBotOutput& out) {
+             FileSystemEngine::listDirectory(args.empty() ? "." : args, out);
+         });
+         registerHandler("disk_usage", [](const std::string& args, TermBotOutput& out) {
+             FileSystemEngine::DiskUsageWalker(out).run(args.empty() ? "." : args);
+         });
+ #endif
+ #ifdef __linux__
+         registerHandler("list_processes", [](const std::string&, TermBotOutput& out) {
+             ProcessMonitor::listProcesses(out);
+         });
+ #endif
+ 
+         const char* persistent = getenv("TERMBOT_PERSISTENT_SHELL");
+         if (persistent != nullptr && std::string(persistent) == "1") {
+             setPersistentShell(true);
+         }
+     }
+ 
+     // Route commands through one long-lived shell instead of a popen per call.
+     // Returns false where no co-process is available (Windows).
+     bool setPersistentShell(bool enabled) {
+ #ifdef _WIN32
+         return !enabled;
+ #else
+         std::lock_guard<std::mutex> lock(shellMutex);
+         if (!enabled) {
+             shell.reset();
+         } else if (!shell) {
+             shell.reset(new ShellSession());
+         }
+         return true;
+ #endif
+     }
+ 
+     bool isPersistentShell() {
+ #ifdef _WIN32
+         return false;
+ #else
+         std::lock_guard<std::mutex> lock(shellMutex);
+         return shell != nullptr;
+ #endif
+     }
+ 
+     // In-process handler for a command word; receives the rest of the line.
+     using Handler = std::function<void(const std::string& args, TermBotOutput& out)>;
+ 
+     // Later registrations replace earlier ones, so a plugin may override a built-in.
+     void registerHandler(const std::string& name, Handler handler) {
+         handlers[name] = std::move(handler);
      }
  
      std::string executeCommand(const std::string& command) {
+         std::string output;
+         TermBotOutput out = stringOutput(output);
+         streamCommand(command, out);
+         return output;
+     }
+ 
+     // Runs a command and writes its output to `out` as it is produced.
+     void streamCommand(const std::string& command, TermBotOutput& out) {
          if (!isSafeCommand(command)) {
-             return "⚠️ Sorry, this command has been blocked for safety reasons.";
+             writeOutput(out, "⚠️ Sorry, this command has been blocked for safety reasons.");
+             return;
+         }
+ 
+         // Count what reaches the caller so an empty result can be reported.
+         struct CountingOutput {
+             TermBotOutput* inner;
+             size_t bytes;
+         } counter{&out, 0};
+         TermBotOutput counted{&counter, [](void* context, const char* data, size_t length) {
+             auto* self = static_cast<CountingOutput*>(context);
+             self->bytes += length;
+             self->inner->write(self->inner->context, data, length);
+         }};
+ 
+         if (cache.cacheable(command)) {
+             writeOutput(counted, cache.get(command, [this, command](std::string& value) {
+                 TermBotOutput captured = stringOutput(value);
+                 return dispatch(command, captured) && !value.empty() &&
+                        value.rfind("⚠️", 0) != 0 && value.rfind("❌", 0) != 0;
+             }));
+         } else if (!dispatch(command, counted)) {
+             writeOutput(out, "❌ Error executing command.");
+             return;
          }
  
-         std::string result;
+         if (counter.bytes == 0) {
+             writeOutput(out, "✅ Command executed successfully (no output).");
+         }
+     }
  
+ private:
+     // Runs a handler or the shell, bypassing the cache. False if the shell
+     // could not be started.
+     bool dispatch(const std::string& command, TermBotOutput& out) {
          // Handle special commands
-         if (command == "get_system_info") return getSystemInfo();
-         if (command == "get_memory_info") return getMemoryInfo();
-         if (command == "get_ip_address") return getIPAddress();
-         if (command == "get_weather") return getWeather();
+         size_t split = command.find(' ');
+         auto handler = handlers.find(command.substr(0, split));
+         if (handler != handlers.end()) {
+             std::string args = split == std::string::npos ? "" : command.substr(split + 1);
+             handler->second(args, out);
+             return true;
+         }
+         return runInShell(command, out);
+     }
+ 
+     bool runInShell(const std::string& command, TermBotOutput& out) {
+ #ifndef _WIN32
+         {
+             // Cache refreshes run on a worker thread and may share the shell.
+             std::lock_guard<std::mutex> lock(shellMutex);
+             if (shell && shell->run(command, out)) {
+                 return true;
+             }
+         }
+ #endif
  
          std::array<char, 128> buffer;
-         std::string output;
  
  #ifdef _WIN32
          std::string fullCommand = "cmd /c " + command + " 2>&1";
@@ -222,17 +1707,15 @@
                  std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(fullCommand.c_str(), "r"), pclose);
         #endif
          if (!pipe) {
-             return "❌ Error executing command.";
+             return false;
          }
  
          while (fgets(buffer.data(), buffer.size(), pipe.get()) != nullptr) {
-             output += buffer.data();
+             out.write(out.context, buffer.data(), std::strlen(buffer.data()));
          }
- 
-         return output.empty() ? "✅ Command executed successfully (no output)." : output;
+         return true;
      }
  
- private:
      std::string getSystemInfo() {
  #ifdef _WIN32
          return executeCommand("systeminfo");
@@ -267,8 +1750,30 @@
  #endif
      }
  
+     // TERMBOT_WEATHER_URL points this at another server, e.g. a local stub
+     // standing in for wttr.in when testing offline. The URL may only use URL
+     // characters, none of which can end the surrounding quotes, and the
+     // command still has to pass isSafeCommand like any other.
      std::string getWeather() {
-         std::string weather = executeCommand("curl -s wttr.in/?format=3");
+         const char* env = getenv("TERMBOT_WEATHER_URL");
+         std::string url = env != nullptr ? env : "wttr.in/?format=3";
+         const std::string allowed = "-._~:/?#[]@!$&()*+,;=%";
+         for (unsigned char c : url) {
+             if (!std::isalnum(c) && allowed.find(static_cast<char>(c)) == std::string::npos) {
+                 return "❌ TERMBOT_WEATHER_URL contains characters that are not allowed in a URL.";
+             }
+         }
+ #ifdef _WIN32
+         std::string command = "curl -s --max-time 10 \"" + url + "\"";
+ #else
+         std::string command = "curl -s --max-time 10 '" + url + "'";
+ #endif
+         if (!isSafeCommand(command)) {
+             return "⚠️ Sorry, this command has been blocked for safety reasons.";
+         }
+         std::string weather;
+         TermBotOutput out = stringOutput(weather);
+         runInShell(command, out);
          return weather.empty() ? "⚠️ Could not fetch weather data. Check internet connection." : weather;
      }
  
@@ -285,6 +1790,12 @@
      }
  
      std::vector<std::string> dangerousCommands;
+     std::map<std::string, Handler> handlers;
+ #ifndef _WIN32
+     std::mutex shellMutex;
+     std::unique_ptr<ShellSession> shell;
+ #endif
+     ResultCache cache;
  };
  
  // NLPEngine definition
@@ -292,13 +1803,21 @@
      std::vector<std::string> keywords;
      std::vector<std::regex> patterns;
      std::string command;
+     // Seconds a speculative run's output may stand in for a real one,
+     // counted from when it finished; 0 never prefetches. Opt-in: only
+     // read-only, cheap commands whose output holds still that long. Clocks,
+     // process and memory figures, network calls and directory walks stay 0,
+     // and so do commands the ResultCache already answers without waiting.
+     int prefetchSeconds = 0;
  };
  
  class NLPEngine {
  public:
      NLPEngine() { initializePatterns(); }
  
-     std::string interpretInput(const std::string& input) {
+     // Const and lock-free: one engine can serve any number of sessions
+     // concurrently once all patterns have been added.
+     std::string interpretInput(const std::string& input) const {
          std::string lowerInput = input;
          std::transform(lowerInput.begin(), lowerInput.end(), lowerInput.begin(),
                         [](unsigned char c) { return std::tolower(c); });
@@ -313,6 +1832,19 @@
          return "";
      }
  
+     // Routes input containing any of `keywords` to `command`. Added after the
+     // built-in patterns, so those keep priority.
+     void addPattern(const std::vector<std::string>& keywords, const std::string& command) {
+         commandPatterns.push_back({keywords, {}, command, 0});
+     }
+ 
+     int prefetchSeconds(const std::string& command) const {
+         for (const auto& pattern : commandPatterns) {
+             if (pattern.command == command) return pattern.prefetchSeconds;
+         }
+         return 0;
+     }
+ 
  private:
      std::vector<CommandPattern> commandPatterns;
  
@@ -345,6 +1877,19 @@
  #else
              "cal"
  #endif
+             , 300
+         });
+ 
+         commandPatterns.push_back({
+             {"usage", "using", "taking", "biggest", "largest"},
+             {std::regex("(what|which).*(using|taking).*space"), std::regex("disk.*usage"),
+              std::regex("(biggest|largest).*(files|folders|directories)")},
+ #ifdef _WIN32
+             "dir /s"
+ #else
+             "disk_usage"
+ #endif
+             , 0
          });
  
          commandPatterns.push_back({
@@ -353,7 +1898,7 @@
  #ifdef _WIN32
              "dir"
  #else
-             "ls -la"
+             "list_files"
  #endif
          });
  
@@ -365,6 +1910,7 @@
  #else
              "pwd"
  #endif
+             , 30
          });
  
          commandPatterns.push_back({
@@ -396,6 +1942,8 @@
              {std::regex("(show|list).*process"), std::regex("running.*program"), std::regex("what.*running")},
  #ifdef _WIN32
              "tasklist"
+ #elif __linux__
+             "list_processes"
  #else
              "ps aux"
  #endif
@@ -419,10 +1967,11 @@
  #else
              "ping -c 3 8.8.8.8"
  #endif
+             , 0
          });
      }
  
-     bool matchesKeywords(const std::string& input, const std::vector<std::string>& keywords) {
+     bool matchesKeywords(const std::string& input, const std::vector<std::string>& keywords) const {
          for (const auto& keyword : keywords) {
              if (input.find(keyword) != std::string::npos) {
                  return true;
@@ -431,7 +1980,7 @@
          return false;
      }
  
-     bool matchesRegex(const std::string& input, const std::vector<std::regex>& patterns) {
+     bool matchesRegex(const std::string& input, const std::vector<std::regex>& patterns) const {
          for (const auto& pattern : patterns) {
              if (std::regex_search(input, pattern)) {
                  return true;
@@ -441,30 +1990,184 @@
      }
  };
  
+ // Everything a session only reads: the NLP patterns and the plugin handlers.
+ // Build it once and share it between any number of TermBot sessions; after
+ // build() it is never modified, so sessions use it without locking. Plugin
+ // handlers must therefore be reentrant.
+ class CompiledEngine {
+ public:
+     static std::shared_ptr<const CompiledEngine> build(const std::string& pluginDirectory = "plugins") {
+         std::shared_ptr<CompiledEngine> engine(new CompiledEngine());
+         engine->loadPlugins(pluginDirectory);
+         return engine;
+     }
+ 
+     const NLPEngine& nlp() const { return nlpEngine; }
+ 
+     const std::map<std::string, CommandHandler::Handler>& pluginHandlers() const { return handlers; }
+ 
+ private:
+ #ifndef _WIN32
+     // Declared first so plugin code stays mapped until every handler is gone.
+     std::vector<std::unique_ptr<void, int (*)(void*)>> pluginHandles;
+ #endif
+     NLPEngine nlpEngine;
+     std::map<std::string, CommandHandler::Handler> handlers;
+ 
+     CompiledEngine() = default;
+ 
+     void loadPlugins(const std::string& directory) {
+ #ifndef _WIN32
+ #ifdef __APPLE__
+         const std::string extension = ".dylib";
+ #else
+         const std::string extension = ".so";
+ #endif
+         DIR* dir = opendir(directory.c_str());
+         if (dir == nullptr) return;
+ 
+         TermBotPluginHost host{TERMBOT_PLUGIN_ABI_VERSION, this, &CompiledEngine::registerPluginHandler};
+         while (dirent* entry = readdir(dir)) {
+             std::string file = entry->d_name;
+             if (file.size() <= extension.size() ||
+                 file.compare(file.size() - extension.size(), extension.size(), extension) != 0) {
+                 continue;
+             }
+ 
+             std::string path = directory + "/" + file;
+             void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+             if (handle == nullptr) {
+                 std::cerr << "Warning: Could not load plugin " << path << ": " << dlerror() << std::endl;
+                 continue;
+             }
+             auto init = reinterpret_cast<TermBotPluginInit>(dlsym(handle, TERMBOT_PLUGIN_INIT_SYMBOL));
+             if (init == nullptr || init(&host) != 0) {
+                 std::cerr << "Warning: Plugin " << path << " failed to initialize." << std::endl;
+                 dlclose(handle);
+                 continue;
+             }
+             pluginHandles.emplace_back(handle, dlclose);
+         }
+         closedir(dir);
+ #else
+         (void)directory;
+ #endif
+     }
+ 
+     static int registerPluginHandler(void* context, const char* command,
+                                      const char* keywords, TermBotHandler handler) {
+         if (command == nullptr || *command == '\0' || std::strchr(command, ' ') != nullptr ||
+             handler == nullptr) {
+             return 1;
+         }
+ 
+         auto* engine = static_cast<CompiledEngine*>(context);
+         std::string name = command;
+         engine->handlers[name] = [name, handler](const std::string& args, TermBotOutput& out) {
+             int status = handler(args.c_str(), &out);
+             if (status != 0) {
+                 writeOutput(out, "\n❌ " + name + " failed (code " + std::to_string(status) + ").");
+             }
+         };
+ 
+         if (keywords != nullptr) {
+             std::vector<std::string> phrases;
+             std::istringstream list(keywords);
+             std::string phrase;
+             while (std::getline(list, phrase, ',')) {
+                 phrase.erase(0, phrase.find_first_not_of(" \t"));
+                 phrase.erase(phrase.find_last_not_of(" \t") + 1);
+                 std::transform(phrase.begin(), phrase.end(), phrase.begin(),
+                                [](unsigned char c) { return std::tolower(c); });
+                 if (!phrase.empty()) phrases.push_back(phrase);
+             }
+             if (!phrases.empty()) engine->nlpEngine.addPattern(phrases, name);
+         }
+         return 0;
+     }
+ };
+ 
+ // First-order Markov model over executed commands. Transitions are learned
+ // from earlier sessions in the log and from the live session.
+ class IntentPredictor {
+ public:
+     void observe(const std::string& from, const std::string& to) {
+         if (from.empty() || to.empty()) return;
+         auto& row = transitions[from];
+         row.counts[to]++;
+         row.total++;
+     }
+ 
+     // Most likely successor of `from`, if it has been seen at least
+     // `minCount` times and accounts for at least `minProbability` of exits.
+     std::string predict(const std::string& from, int minCount = 2, double minProbability = 0.3) const {
+         auto row = transitions.find(from);
+         if (row == transitions.end()) return "";
+ 
+         const std::string* best = nullptr;
+         int bestCount = 0;
+         for (const auto& next : row->second.counts) {
+             if (next.second > bestCount) {
+                 best = &next.first;
+                 bestCount = next.second;
+             }
+         }
+         if (best == nullptr || bestCount < minCount ||
+             bestCount < minProbability * row->second.total) {
+             return "";
+         }
+         return *best;
+     }
+ 
+ private:
+     struct Row {
+         std::map<std::string, int> counts;
+         int total = 0;
+     };
+     std::map<std::string, Row> transitions;
+ };
+ 
  // TermBot definition
  class TermBot {
- public:
-     TermBot() {
-         SystemUtils::createDirectoryIfNotExists("logs");
-         SystemUtils::createDirectoryIfNotExists("data");
+     friend class TermBotBench;
  
-         logFile.open("logs/termbot_log.txt", std::ios::app);
+ public:
+     // Where a session keeps its own state. Sessions sharing an engine in one
+     // process should each get their own directories.
+     struct SessionConfig {
+         std::string logDirectory = "logs";
+         std::string dataDirectory = "data";
+     };
+ 
+     TermBot() : TermBot(CompiledEngine::build(), SessionConfig()) {}
+ 
+     TermBot(std::shared_ptr<const CompiledEngine> engine, const SessionConfig& config)
+         : engine(std::move(engine)),
+           commandHandler(config.dataDirectory),
+           logPath(config.logDirectory + "/termbot_log.txt"),
+           aliasPath(config.dataDirectory + "/aliases.txt") {
+         SystemUtils::createDirectoryIfNotExists(config.logDirectory);
+         SystemUtils::createDirectoryIfNotExists(config.dataDirectory);
+ 
+         logFile.open(logPath, std::ios::app);
          if (!logFile.is_open()) {
              std::cerr << "Warning: Could not open log file. Logging disabled." << std::endl;
          } else {
-             std::time_t now = std::time(nullptr);
-             logFile << "\n--- TermBot Session Started: " << std::ctime(&now);
+             logFile << "\n--- TermBot Session Started: " << timestamp("%a %b %e %H:%M:%S %Y") << std::endl;
              logFile.flush();
          }
  
+         for (const auto& handler : this->engine->pluginHandlers()) {
+             commandHandler.registerHandler(handler.first, handler.second);
+         }
          loadAliases();
          initializeEasterEggs();
+         learnFromLog(logPath);
      }
  
      ~TermBot() {
          if (logFile.is_open()) {
-             std::time_t now = std::time(nullptr);
-             logFile << "--- TermBot Session Ended: " << std::ctime(&now);
+             logFile << "--- TermBot Session Ended: " << timestamp("%a %b %e %H:%M:%S %Y") << std::endl;
              logFile.close();
          }
      }
@@ -488,6 +2191,62 @@
              printBanner();
              return;
          }
+         if (input == "prefetch stats") {
+             int misses = prefetchIssued - prefetchHits;
+             response = "🔮 Prefetch: " + std::to_string(prefetchIssued) + " issued, " +
+                        std::to_string(prefetchHits) + " hits, " + std::to_string(misses) + " unused";
+             if (prefetchIssued > 0) {
+                 response += " (" + std::to_string(100 * prefetchHits / prefetchIssued) + "% hit rate)";
+             }
+             printColoredText(response, Color::cyan);
+             return;
+         }
+         if (input == "persistent shell on" || input == "persistent shell off") {
+             bool enable = input == "persistent shell on";
+             if (commandHandler.setPersistentShell(enable)) {
+                 response = enable ? "✅ Commands now run in one persistent shell."
+                                   : "✅ Commands now run in a fresh shell each time.";
+                 printColoredText(response, Color::green);
+             } else {
+                 response = "❌ A persistent shell is not available on this platform.";
+                 printColoredText(response, Color::red);
+             }
+             logInteraction(input, response);
+             return;
+         }
+ 
+         static const std::regex watchProcessesPattern("watch (processes|process|top)(?: every (\\d+) ?(ms|s))?",
+                                                       std::regex::icase);
+         std::smatch watchMatch;
+         if (std::regex_match(input, watchMatch, watchProcessesPattern)) {
+             int interval = 1000;
+             if (watchMatch[2].matched) {
+                 interval = watchInterval(watchMatch[2].str(), watchMatch[3].str());
+             }
+             response = watchProcesses(interval);
+             logInteraction(input, response);
+             return;
+         }
+ 
+         static const std::regex watchPattern("watch (.+?)(?: every (\\d+) ?(ms|s|sec|secs|seconds))?",
+                                              std::regex::icase);
+         if (std::regex_match(input, watchMatch, watchPattern)) {
+             int interval = 2000;
+             if (watchMatch[2].matched) {
+                 interval = watchInterval(watchMatch[2].str(), watchMatch[3].str());
+             }
+             std::string query = watchMatch[1].str();
+             std::string watched = resolveAlias(query);
+             if (watched.empty()) watched = engine->nlp().interpretInput(query);
+             if (watched.empty()) {
+                 response = "😕 I don't know what to watch for \"" + query + "\". Try 'watch disk space every 5 s'.";
+                 printColoredText(response, Color::yellow);
+             } else {
+                 response = watchCommand(query, watched, interval);
+             }
+             logInteraction(input, response);
+             return;
+         }
  
          if (checkForEasterEgg(input, response)) {
              showTypingEffect(response);
@@ -521,22 +2280,21 @@
              }
          }
  
-         for (const auto& alias : aliases) {
-             if (input == alias.first) {
-                 std::cout << "🔄 Using alias: " << alias.second << std::endl;
-                 command = alias.second;
-                 break;
-             }
-         }
- 
-         if (command.empty()) {
-             command = nlpEngine.interpretInput(input);
+         command = resolveAlias(input);
+         if (!command.empty()) {
+             std::cout << "🔄 Using alias: " << command << std::endl;
+         } else {
+             command = engine->nlp().interpretInput(input);
          }
  
          if (!command.empty()) {
-             showLoadingAnimation(500);
-             response = commandHandler.executeCommand(command);
-             std::cout << response << std::endl;
+             if (!takePrefetched(command, response)) {
+                 showLoadingAnimation(500);
+                 response = runCommand(command);
+             }
+             predictor.observe(lastCommand, command);
+             lastCommand = command;
+             prefetchNext(command);
          } else {
              std::string suggestion = getSuggestedCommand(input);
              if (!suggestion.empty()) {
@@ -556,17 +2314,210 @@
      }
  
  private:
+     struct PrefetchResult {
+         std::string output;
+         std::chrono::steady_clock::time_point finishedAt;
+     };
+     struct Prefetch {
+         std::shared_future<PrefetchResult> result;
+         std::chrono::seconds freshFor;
+     };
+ 
+     // Shared and immutable; declared first so plugin code outlives the
+     // handlers copied into commandHandler.
+     std::shared_ptr<const CompiledEngine> engine;
+     // Everything below is this session's own state.
      CommandHandler commandHandler;
-     NLPEngine nlpEngine;
+     std::string logPath;
+     std::string aliasPath;
      std::map<std::string, std::string> aliases;
      std::ofstream logFile;
      std::map<std::string, std::string> eastereggs;
+     IntentPredictor predictor;
+     std::string lastCommand;
+     std::map<std::string, Prefetch> prefetched;
+     int prefetchIssued = 0;
+     int prefetchHits = 0;
+     BackgroundWorker prefetchWorker; // after everything its jobs touch
+ 
+     std::string resolveAlias(const std::string& input) const {
+         auto alias = aliases.find(input);
+         return alias == aliases.end() ? "" : alias->second;
+     }
+ 
+     // Replays the User: lines of earlier sessions through alias and NLP
+     // resolution to seed the transition model.
+     void learnFromLog(const std::string& path) {
+         std::ifstream file(path);
+         std::string line;
+         std::string previous;
+         const std::string marker = "] User: ";
+         while (std::getline(file, line)) {
+             if (line.rfind("--- TermBot Session", 0) == 0) {
+                 previous.clear();
+                 continue;
+             }
+             size_t pos = line.find(marker);
+             if (line.empty() || line[0] != '[' || pos == std::string::npos) continue;
+ 
+             std::string input = line.substr(pos + marker.size());
+             std::string command = resolveAlias(input);
+             if (command.empty()) command = engine->nlp().interpretInput(input);
+             if (command.empty()) continue;
+             predictor.observe(previous, command);
+             previous = command;
+         }
+     }
+ 
+     // Speculatively runs the most likely next command on the idle worker, so
+     // its output is ready if that is what the user asks for next.
+     void prefetchNext(const std::string& command) {
+         prefetched.clear();
+         std::string next = predictor.predict(command);
+         int freshFor = next.empty() ? 0 : engine->nlp().prefetchSeconds(next);
+         if (freshFor <= 0 || next == command || !prefetchWorker.idle()) {
+             return;
+         }
+ 
+         auto task = std::make_shared<std::packaged_task<PrefetchResult()>>([this, next] {
+             std::string output = commandHandler.executeCommand(next);
+             return PrefetchResult{output, std::chrono::steady_clock::now()};
+         });
+         prefetched[next] = {task->get_future().share(), std::chrono::seconds(freshFor)};
+         prefetchWorker.post([task] { (*task)(); });
+         prefetchIssued++;
+     }
+ 
+     // Uses a prefetched result for `command` if it finished recently enough
+     // to still be current; waits for it if it is still running.
+     bool takePrefetched(const std::string& command, std::string& response) {
+         auto it = prefetched.find(command);
+         if (it == prefetched.end()) return false;
+         Prefetch prefetch = it->second;
+         prefetched.erase(it);
+ 
+         const PrefetchResult& result = prefetch.result.get();
+         if (std::chrono::steady_clock::now() - result.finishedAt > prefetch.freshFor) return false;
+         response = result.output;
+         std::cout << response << std::endl;
+         prefetchHits++;
+         return true;
+     }
+ 
+     // Streams command output to the terminal as it arrives and returns the
+     // start of it for the log, so large outputs are never held twice.
+     std::string runCommand(const std::string& command) {
+         struct EchoOutput {
+             std::string logged;
+             bool truncated;
+         } echo{"", false};
+         TermBotOutput out{&echo, [](void* context, const char* data, size_t length) {
+             auto* self = static_cast<EchoOutput*>(context);
+             std::cout.write(data, static_cast<std::streamsize>(length));
+             const size_t logLimit = 4096;
+             if (self->logged.size() < logLimit) {
+                 self->logged.append(data, std::min(length, logLimit - self->logged.size()));
+             }
+             self->truncated = self->truncated || self->logged.size() == logLimit;
+         }};
+         commandHandler.streamCommand(command, out);
+         std::cout << std::endl;
+         return echo.truncated ? echo.logged + "... [truncated]" : echo.logged;
+     }
+ 
+     // Milliseconds for "every <digits> <unit>", where unit is ms or any
+     // spelling of seconds. Clamped to 100 ms .. 1 hour before scaling, so
+     // huge numbers neither throw nor overflow.
+     static int watchInterval(const std::string& digits, const std::string& unit) {
+         const long long maxMs = 60 * 60 * 1000;
+         long long value = std::strtoll(digits.c_str(), nullptr, 10); // saturates on overflow
+         std::string lowerUnit = unit;
+         std::transform(lowerUnit.begin(), lowerUnit.end(), lowerUnit.begin(),
+                        [](unsigned char c) { return std::tolower(c); });
+         value = lowerUnit == "ms" ? std::min(value, maxMs) : std::min(value, maxMs / 1000) * 1000;
+         return static_cast<int>(std::max(value, 100LL));
+     }
+ 
+     // top-like view: rescans every `intervalMs` and repaints only changed rows
+     // until the user presses Enter.
+     std::string watchProcesses(int intervalMs) {
+ #ifdef __linux__
+         ProcessMonitor::ProcessTable table;
+         FileSystemEngine::NameCache names;
+         ScreenRenderer screen;
+         int refreshes = 0;
+         do {
+             const auto& snapshot = table.scan();
+             std::vector<const ProcessMonitor::ProcessInfo*> rows;
+             rows.reserve(snapshot.size());
+             for (const auto& info : snapshot) rows.push_back(&info);
+             ProcessMonitor::sortByActivity(rows);
+ 
+             int height, width;
+             terminalSize(height, width);
+             std::vector<std::string> lines;
+             lines.push_back(std::to_string(snapshot.size()) + " processes, every " +
+                             std::to_string(intervalMs) + " ms. Press Enter to stop.");
+             lines.push_back(ProcessMonitor::header());
+             size_t visible = std::min(rows.size(), static_cast<size_t>(std::max(height - 3, 1)));
+             for (size_t i = 0; i < visible; ++i) {
+                 std::string line = ProcessMonitor::formatRow(*rows[i], names);
+                 if (line.size() > static_cast<size_t>(width)) line.resize(width);
+                 lines.push_back(line);
+             }
+             screen.render(lines, height);
+             refreshes++;
+         } while (!waitForEnter(intervalMs));
+         return "Watched processes (" + std::to_string(refreshes) + " refreshes)";
+ #else
+         (void)intervalMs;
+         std::string response = "❌ watch processes needs /proc and is only available on Linux.";
+         printColoredText(response, Color::red);
+         return response;
+ #endif
+     }
+ 
+     // Like watch(1): reruns an already-resolved command on a timer and
+     // repaints only what changed, until the user presses Enter.
+     std::string watchCommand(const std::string& query, const std::string& command, int intervalMs) {
+         ScreenRenderer screen;
+         int refreshes = 0;
+         do {
+             std::string output = commandHandler.executeCommand(command);
+ 
+             int height, width;
+             terminalSize(height, width);
+             std::time_t now = std::time(nullptr);
+             char clock[16];
+             std::tm local = SystemUtils::localTime(now);
+             std::strftime(clock, sizeof(clock), "%H:%M:%S", &local);
+             std::vector<std::string> lines;
+             lines.push_back("Every " + std::to_string(intervalMs) + " ms: " + query + " (" + command + ")  " +
+                             clock + ". Press Enter to stop.");
+             lines.push_back("");
+ 
+             std::istringstream stream(output);
+             std::string line;
+             while (lines.size() + 1 < static_cast<size_t>(height) && std::getline(stream, line)) {
+                 if (!line.empty() && line.back() == '\r') line.pop_back();
+                 std::string expanded;
+                 for (char c : line) {
+                     if (c == '\t') expanded.append(8 - expanded.size() % 8, ' ');
+                     else expanded += c;
+                 }
+                 if (expanded.size() > static_cast<size_t>(width)) expanded.resize(width);
+                 lines.push_back(expanded);
+             }
+             screen.render(lines, height);
+             refreshes++;
+         } while (!waitForEnter(intervalMs));
+         return "Watched " + command + " (" + std::to_string(refreshes) + " refreshes)";
+     }
  
      void loadAliases() {
-         std::ifstream file("data/aliases.txt");
+         std::ifstream file(aliasPath);
          if (!file.is_open()) {
-             SystemUtils::createDirectoryIfNotExists("data");
-             std::ofstream createFile("data/aliases.txt");
+             std::ofstream createFile(aliasPath);
              if (createFile.is_open()) createFile.close();
              return;
          }
@@ -584,7 +2535,7 @@
      }
  
      void saveAliases() {
-         std::ofstream file("data/aliases.txt");
+         std::ofstream file(aliasPath);
          if (!file.is_open()) {
              std::cerr << "Error saving aliases: Could not open file." << std::endl;
              return;
@@ -596,16 +2547,20 @@
          file.close();
      }
  
+     static std::string timestamp(const char* format) {
+         std::tm timeinfo = SystemUtils::localTime(std::time(nullptr));
+         char text[32];
+         std::strftime(text, sizeof(text), format, &timeinfo);
+         return text;
+     }
+ 
      void logInteraction(const std::string& input, const std::string& response) {
          if (!logFile.is_open()) return;
  
-         std::time_t now = std::time(nullptr);
-         struct tm* timeinfo = std::localtime(&now);
-         char timestamp[20];
-         std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", timeinfo);
+         std::string now = timestamp("%Y-%m-%d %H:%M:%S");
  
-         logFile << "[" << timestamp << "] User: " << input << std::endl;
-         logFile << "[" << timestamp << "] Bot: " << response << std::endl;
+         logFile << "[" << now << "] User: " << input << std::endl;
+         logFile << "[" << now << "] Bot: " << response << std::endl;
          logFile.flush();
      }
  
@@ -615,16 +2570,23 @@
          std::cout << "• Natural language commands:" << std::endl;
          std::cout << "  - \"What time is it?\"" << std::endl;
          std::cout << "  - \"List files in this folder\"" << std::endl;
+         std::cout << "  - \"What is using space here?\"" << std::endl;
+         std::cout << "  - \"watch processes every 500 ms\" (Enter stops)" << std::endl;
+         std::cout << "  - \"watch disk space every 5 s\" (reruns any request)" << std::endl;
          std::cout << "  - \"Show available memory\"" << std::endl;
          std::cout << "  - \"What's my IP address?\"" << std::endl;
          std::cout << "  - \"Check the weather\"" << std::endl;
          std::cout << "\n• Aliases:" << std::endl;
          std::cout << "  - Create: alias name=command" << std::endl;
          std::cout << "  - Example: alias weather=curl wttr.in/?format=3" << std::endl;
+         std::cout << "\n• Plugins:" << std::endl;
+         std::cout << "  - Shared objects in ./plugins add their own commands (see termbot_plugin.h)" << std::endl;
          std::cout << "\n• System Commands:" << std::endl;
          std::cout << "  - help   : Show this menu" << std::endl;
          std::cout << "  - menu   : Show interactive menu" << std::endl;
          std::cout << "  - clear  : Clear the screen" << std::endl;
+         std::cout << "  - persistent shell on|off : Reuse one shell for all commands" << std::endl;
+         std::cout << "  - prefetch stats : Show how often predicted commands were used" << std::endl;
          std::cout << "  - exit   : Exit TermBot" << std::endl;
          std::cout << "===================" << std::endl;
      }
@@ -764,6 +2726,8 @@
  };
  
  // Main function
+ // termbot_bench.cpp includes this file with TERMBOT_NO_MAIN defined.
+ #ifndef TERMBOT_NO_MAIN
  int main() {
      clearScreen();
      printBanner();
@@ -786,4 +2750,5 @@
      }
  
      return 0;
- }
\ No newline at end of file
+ }
+ #endif
@@ -0,0 +1,314 @@
+/**
+ * TermBot request-path benchmark
+ *
+ * Replays a corpus of user inputs through everything TermBot does before it
+ * runs a command: easter eggs, alias resolution, NLPEngine::interpretInput,
+ * isSafeCommand and getSuggestedCommand. Nothing is executed. For each
+ * stage it reports throughput, heap allocations per call and latency
+ * percentiles.
+ *
+ * The bot under test keeps its log and data in a scratch directory that is
+ * removed afterwards, and loads plugins from an empty directory, so the
+ * bench neither reads nor writes the real logs/, data/ or plugins/.
+ *
+ * Build and run:
+ *   g++ -std=c++17 -O2 -pthread -o termbot_bench termbot_bench.cpp
+ *   ./termbot_bench                     (synthetic corpus, 1k and 100k entries)
+ *   ./termbot_bench --full              (adds the 10M-entry corpus)
+ *   ./termbot_bench --log logs/termbot_log.txt --sizes 100000
+ *   ./termbot_bench --threads 8         (also checks shared-engine scaling)
+ */
+
+ #define TERMBOT_NO_MAIN
+ #include "termbot.cpp"
+
+ #include <new>
+ #include <random>
+ #include <iomanip>
+ #include <filesystem>
+
+ // Every heap allocation in the process is counted, so allocs/op covers the
+ // standard library as well as TermBot's own code. The replacements are kept
+ // out of line: inlined, GCC pairs a new-expression with the std::free inside
+ // operator delete and reports -Wmismatched-new-delete.
+ static std::atomic<uint64_t> allocationCount{0};
+
+ #ifdef __GNUC__
+ #define BENCH_NOINLINE __attribute__((noinline))
+ #else
+ #define BENCH_NOINLINE
+ #endif
+
+ BENCH_NOINLINE void* operator new(size_t size) {
+     allocationCount.fetch_add(1, std::memory_order_relaxed);
+     if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+     throw std::bad_alloc();
+ }
+
+ BENCH_NOINLINE void* operator new[](size_t size) {
+     allocationCount.fetch_add(1, std::memory_order_relaxed);
+     if (void* p = std::malloc(size == 0 ? 1 : size)) return p;
+     throw std::bad_alloc();
+ }
+
+ BENCH_NOINLINE void operator delete(void* p) noexcept { std::free(p); }
+ BENCH_NOINLINE void operator delete(void* p, size_t) noexcept { std::free(p); }
+ BENCH_NOINLINE void operator delete[](void* p) noexcept { std::free(p); }
+ BENCH_NOINLINE void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+ // A fresh directory under the system temp directory, removed with
+ // everything in it on destruction.
+ class ScratchDirectory {
+ public:
+     ScratchDirectory() {
+         path = (std::filesystem::temp_directory_path() /
+                 ("termbot_bench_" + std::to_string(
+                     std::chrono::steady_clock::now().time_since_epoch().count()))).string();
+         std::filesystem::create_directories(path + "/plugins");
+     }
+
+     ~ScratchDirectory() {
+         std::error_code error;
+         std::filesystem::remove_all(path, error);
+     }
+
+     ScratchDirectory(const ScratchDirectory&) = delete;
+     ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+     TermBot::SessionConfig config() const {
+         TermBot::SessionConfig config;
+         config.logDirectory = path + "/logs";
+         config.dataDirectory = path + "/data";
+         return config;
+     }
+
+     std::string path;
+ };
+
+ class TermBotBench {
+ public:
+     TermBotBench() : bot(CompiledEngine::build(scratch.path + "/plugins"), scratch.config()) {
+         // Enough aliases that resolution is not a one-entry map lookup.
+         for (int i = 0; i < 64; ++i) {
+             bot.aliases["alias" + std::to_string(i)] = "echo alias " + std::to_string(i);
+         }
+     }
+
+     void run(const std::vector<std::string>& corpus) {
+         std::cout << "\nCorpus: " << corpus.size() << " inputs" << std::endl;
+         std::cout << std::left << std::setw(18) << "stage" << std::right
+                   << std::setw(14) << "ops/sec" << std::setw(12) << "allocs/op"
+                   << std::setw(10) << "p50 us" << std::setw(10) << "p90 us"
+                   << std::setw(10) << "p99 us" << std::setw(10) << "p99.9 us" << std::endl;
+ 
+         std::string response;
+         measure("easter_egg", corpus, [&](const std::string& input) {
+             return bot.checkForEasterEgg(input, response) ? 1 : 0;
+         });
+         measure("alias", corpus, [&](const std::string& input) {
+             return bot.resolveAlias(input).size();
+         });
+         measure("interpret", corpus, [&](const std::string& input) {
+             return bot.engine->nlp().interpretInput(input).size();
+         });
+         measure("is_safe", corpus, [&](const std::string& input) {
+             return bot.commandHandler.isSafeCommand(input) ? 1 : 0;
+         });
+         measure("suggest", corpus, [&](const std::string& input) {
+             return bot.getSuggestedCommand(input).size();
+         });
+         // processInput up to the point where it would execute or prompt.
+         measure("request_path", corpus, [&](const std::string& input) {
+             if (bot.checkForEasterEgg(input, response)) return response.size();
+             std::string command = bot.resolveAlias(input);
+             if (command.empty()) command = bot.engine->nlp().interpretInput(input);
+             if (command.empty()) return bot.getSuggestedCommand(input).size();
+             return bot.commandHandler.isSafeCommand(command) ? command.size() : 0;
+         });
+     }
+ 
+     // interpretInput on one shared engine from 1..maxThreads threads at once.
+     // With no locks on that path, throughput should grow with the thread count.
+     void runShared(const std::vector<std::string>& corpus, unsigned maxThreads) {
+         const NLPEngine& nlp = bot.engine->nlp();
+         std::cout << "\nShared engine, interpret stage" << std::endl;
+         std::cout << std::left << std::setw(18) << "threads" << std::right << std::setw(14) << "ops/sec"
+                   << std::setw(12) << "speedup" << std::endl;
+         std::vector<unsigned> steps;
+         for (unsigned threads = 1; threads < maxThreads; threads *= 2) steps.push_back(threads);
+         steps.push_back(maxThreads);
+ 
+         double single = 0;
+         for (unsigned threads : steps) {
+             std::atomic<size_t> sink{0};
+             auto begin = std::chrono::steady_clock::now();
+             std::vector<std::thread> workers;
+             for (unsigned t = 0; t < threads; ++t) {
+                 workers.emplace_back([&] {
+                     size_t local = 0;
+                     for (const auto& input : corpus) local += nlp.interpretInput(input).size();
+                     sink += local;
+                 });
+             }
+             for (auto& worker : workers) worker.join();
+             double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+             double rate = threads * corpus.size() / seconds;
+             if (threads == 1) single = rate;
+             std::cout << std::left << std::setw(18) << threads << std::right << std::fixed
+                       << std::setw(14) << std::setprecision(0) << rate
+                       << std::setw(11) << std::setprecision(2) << rate / single << "x" << std::endl;
+         }
+     }
+ 
+ private:
+     ScratchDirectory scratch; // declared first, so it outlives the bot
+     TermBot bot;
+ 
+     template <typename Stage>
+     void measure(const std::string& name, const std::vector<std::string>& corpus, Stage stage) {
+         std::vector<uint32_t> latencies(corpus.size());
+         size_t sink = 0;
+         uint64_t allocationsBefore = allocationCount.load();
+         auto begin = std::chrono::steady_clock::now();
+         for (size_t i = 0; i < corpus.size(); ++i) {
+             auto start = std::chrono::steady_clock::now();
+             sink += stage(corpus[i]);
+             auto end = std::chrono::steady_clock::now();
+             latencies[i] = static_cast<uint32_t>(
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+         }
+         double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+         // The latencies vector was allocated before the count was taken.
+         double allocations = static_cast<double>(allocationCount.load() - allocationsBefore) / corpus.size();
+ 
+         std::sort(latencies.begin(), latencies.end());
+         auto percentile = [&](double p) {
+             size_t index = std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()));
+             return latencies[index] / 1000.0;
+         };
+         std::cout << std::left << std::setw(18) << name << std::right << std::fixed
+                   << std::setw(14) << std::setprecision(0) << corpus.size() / seconds
+                   << std::setw(12) << std::setprecision(2) << allocations
+                   << std::setw(10) << percentile(0.50) << std::setw(10) << percentile(0.90)
+                   << std::setw(10) << percentile(0.99) << std::setw(10) << percentile(0.999)
+                   << std::endl;
+         if (sink == 42) std::cout << "";
+     }
+ };
+ 
+ // User: lines of a TermBot log, in order.
+ std::vector<std::string> loadLogCorpus(const std::string& path) {
+     std::vector<std::string> inputs;
+     std::ifstream file(path);
+     std::string line;
+     const std::string marker = "] User: ";
+     while (std::getline(file, line)) {
+         size_t pos = line.find(marker);
+         if (!line.empty() && line[0] == '[' && pos != std::string::npos) {
+             inputs.push_back(line.substr(pos + marker.size()));
+         }
+     }
+     return inputs;
+ }
+ 
+ // A deterministic mix of recognised requests, near-misses that exercise
+ // suggestions, easter eggs, aliases, unsafe commands and noise.
+ std::vector<std::string> syntheticCorpus(size_t size) {
+     const std::vector<std::string> requests = {
+         "what time is it", "tell me the time", "what's today's date", "show calendar",
+         "show files", "list files in this folder", "what is using space here",
+         "where am i", "current directory", "system info", "tell me about this computer",
+         "how much memory is free", "memory usage", "what's my ip address", "show ip",
+         "how's the weather", "weather forecast", "is it going to rain", "show processes",
+         "what is running", "how much disk space", "storage space", "check connection",
+         "am i online", "Show Files", "WHAT TIME IS IT?"
+     };
+     const std::vector<std::string> nearMisses = {
+         "shw files", "what tim is it", "lst processes", "curent directory", "how mch memory",
+         "sho weather", "chek connection", "alis3", "alias9x"
+     };
+     const std::vector<std::string> eggs = {
+         "tell me a joke", "who are you", "hello world", "do a barrel roll", "I'm bored"
+     };
+     const std::vector<std::string> unsafe = {
+         "rm -rf /", "sudo shutdown now", "dd if=/dev/zero of=/dev/sda", "chmod -R 777 /"
+     };
+     const std::vector<std::string> words = {
+         "please", "could", "you", "the", "a", "now", "quickly", "again", "for", "me", "banana", "xyzzy"
+     };
+ 
+     std::mt19937_64 rng(20261019);
+     std::vector<std::string> corpus;
+     corpus.reserve(size);
+     for (size_t i = 0; i < size; ++i) {
+         unsigned kind = rng() % 100;
+         if (kind < 55) {
+             std::string input = requests[rng() % requests.size()];
+             if (rng() % 4 == 0) input = words[rng() % words.size()] + " " + input;
+             corpus.push_back(input);
+         } else if (kind < 70) {
+             corpus.push_back(nearMisses[rng() % nearMisses.size()]);
+         } else if (kind < 78) {
+             corpus.push_back(eggs[rng() % eggs.size()]);
+         } else if (kind < 86) {
+             corpus.push_back("alias" + std::to_string(rng() % 64));
+         } else if (kind < 90) {
+             corpus.push_back(unsafe[rng() % unsafe.size()]);
+         } else {
+             std::string noise;
+             for (unsigned w = 0, n = 1 + rng() % 6; w < n; ++w) {
+                 noise += (w ? " " : "") + words[rng() % words.size()];
+             }
+             corpus.push_back(noise);
+         }
+     }
+     return corpus;
+ }
+ 
+ int main(int argc, char* argv[]) {
+     std::vector<size_t> sizes = {1000, 100000};
+     std::string logPath;
+     unsigned threads = 0;
+     for (int i = 1; i < argc; ++i) {
+         std::string arg = argv[i];
+         if (arg == "--full") {
+             sizes = {1000, 100000, 10000000};
+         } else if (arg == "--sizes" && i + 1 < argc) {
+             sizes.clear();
+             std::istringstream list(argv[++i]);
+             std::string size;
+             while (std::getline(list, size, ',')) sizes.push_back(std::stoull(size));
+         } else if (arg == "--log" && i + 1 < argc) {
+             logPath = argv[++i];
+         } else if (arg == "--threads" && i + 1 < argc) {
+             threads = static_cast<unsigned>(std::stoul(argv[++i]));
+         } else {
+             std::cerr << "Usage: " << argv[0] << " [--full] [--sizes N,N,...] [--log path] [--threads N]" << std::endl;
+             return 1;
+         }
+     }
+ 
+     std::vector<std::string> logInputs;
+     if (!logPath.empty()) {
+         logInputs = loadLogCorpus(logPath);
+         if (logInputs.empty()) {
+             std::cerr << "No User: lines found in " << logPath << std::endl;
+             return 1;
+         }
+     }
+ 
+     TermBotBench bench;
+     for (size_t size : sizes) {
+         std::vector<std::string> corpus;
+         if (logInputs.empty()) {
+             corpus = syntheticCorpus(size);
+         } else {
+             // Replay the log in order, repeating it to reach the requested size.
+             corpus.reserve(size);
+             for (size_t i = 0; i < size; ++i) corpus.push_back(logInputs[i % logInputs.size()]);
+         }
+         bench.run(corpus);
+         if (threads > 0) bench.runShared(corpus, threads);
+     }
+     return 0;
+ }
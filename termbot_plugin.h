@@ -0,0 +1,55 @@
+/**
+ * TermBot plugin ABI
+ *
+ * A plugin is a shared object placed in the "plugins" directory next to
+ * TermBot's "logs" and "data" folders. At startup TermBot dlopen()s every
+ * .so (.dylib on macOS) there and calls its termbot_plugin_init(), which
+ * registers one or more intent handlers. Handlers run in-process: no shell
+ * or subprocess is spawned, and output is appended straight into the
+ * response buffer through TermBotOutput.
+ *
+ * Build a plugin with:
+ *   g++ -std=c++17 -shared -fPIC -o plugins/diag.so diag.cpp
+ */
+
+ #ifndef TERMBOT_PLUGIN_H
+ #define TERMBOT_PLUGIN_H
+
+ #include <stddef.h>
+
+ #define TERMBOT_PLUGIN_ABI_VERSION 1
+ #define TERMBOT_PLUGIN_INIT_SYMBOL "termbot_plugin_init"
+
+ #ifdef __cplusplus
+ extern "C" {
+ #endif
+
+ // Output sink handed to every handler. write() appends directly to the
+ // host's response buffer; the data only has to stay valid for the call.
+ typedef struct TermBotOutput {
+     void* context;
+     void (*write)(void* context, const char* data, size_t length);
+ } TermBotOutput;
+
+ // args is the text after the command name (empty string if none).
+ // Return 0 on success; anything else is reported as a failed command.
+ typedef int (*TermBotHandler)(const char* args, TermBotOutput* out);
+
+ typedef struct TermBotPluginHost {
+     unsigned abi_version;
+     void* context;
+     // Registers `command` (a single word such as "diag_net"). `keywords` is an
+     // optional comma-separated list of phrases that route natural language
+     // input to it, e.g. "diagnostics,health check". Returns 0 on success.
+     int (*register_handler)(void* context, const char* command,
+                             const char* keywords, TermBotHandler handler);
+ } TermBotPluginHost;
+
+ // Exported by every plugin as termbot_plugin_init. Return 0 to stay loaded.
+ typedef int (*TermBotPluginInit)(const TermBotPluginHost* host);
+
+ #ifdef __cplusplus
+ }
+ #endif
+
+ #endif // TERMBOT_PLUGIN_H